@@ -0,0 +1,91 @@
+#include "Benchmark.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+BenchmarkRunner::BenchmarkRunner(uint32_t warmup, uint32_t repetitions)
+    : m_Warmup(warmup), m_Repetitions(std::max(repetitions, 1u))
+{
+}
+
+void BenchmarkRunner::run(const std::string& name, const std::function<uint64_t()>& function)
+{
+    for (uint32_t i = 0; i < m_Warmup; i++)
+    {
+        function();
+    }
+
+    std::vector<double> times(m_Repetitions);
+    uint64_t items = 0;
+    for (uint32_t i = 0; i < m_Repetitions; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        items = function();
+        auto end = std::chrono::steady_clock::now();
+
+        times[i] = std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    std::sort(times.begin(), times.end());
+
+    BenchmarkResult result;
+    result.name = name;
+    result.repetitions = m_Repetitions;
+    result.min = times.front();
+    result.max = times.back();
+    result.median = times.size() % 2 == 1
+                        ? times[times.size() / 2]
+                        : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2.0;
+
+    double sum = 0.0;
+    for (double time : times)
+    {
+        sum += time;
+    }
+    result.mean = sum / times.size();
+
+    double variance = 0.0;
+    for (double time : times)
+    {
+        variance += (time - result.mean) * (time - result.mean);
+    }
+    result.stddev = std::sqrt(variance / times.size());
+
+    result.itemsPerSecond = result.median > 0.0 ? items / (result.median / 1000.0) : 0.0;
+
+    std::printf("%-40s median %10.3f ms  mean %10.3f ms  stddev %8.3f ms  %14.0f items/s\n",
+                name.c_str(), result.median, result.mean, result.stddev, result.itemsPerSecond);
+
+    m_Results.push_back(result);
+}
+
+bool BenchmarkRunner::writeJson(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        spdlog::error("Failed to open {}", path);
+        return false;
+    }
+
+    file << "{\n  \"warmup\": " << m_Warmup << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < m_Results.size(); i++)
+    {
+        const BenchmarkResult& result = m_Results[i];
+        file << "    { \"name\": \"" << result.name << "\", \"repetitions\": " << result.repetitions
+             << ", \"mean_ms\": " << result.mean << ", \"median_ms\": " << result.median
+             << ", \"min_ms\": " << result.min << ", \"max_ms\": " << result.max
+             << ", \"stddev_ms\": " << result.stddev
+             << ", \"items_per_second\": " << result.itemsPerSecond << " }"
+             << (i + 1 < m_Results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+
+    std::printf("Wrote %s\n", path.c_str());
+    return true;
+}
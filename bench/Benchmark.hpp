@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+    std::string name;
+    uint32_t repetitions;
+    // Per repetition, in milliseconds
+    double mean;
+    double median;
+    double min;
+    double max;
+    double stddev;
+    // Items reported by the benchmark per second of median time
+    double itemsPerSecond;
+};
+
+// Runs each benchmark for a number of untimed warmup repetitions, then times every
+// repetition separately and keeps the statistics
+class BenchmarkRunner
+{
+  public:
+    BenchmarkRunner(uint32_t warmup, uint32_t repetitions);
+
+    // The function runs one repetition and returns how many items it processed
+    void run(const std::string& name, const std::function<uint64_t()>& function);
+
+    const std::vector<BenchmarkResult>& getResults() const { return m_Results; }
+    bool writeJson(const std::string& path) const;
+
+  private:
+    uint32_t m_Warmup;
+    uint32_t m_Repetitions;
+
+    std::vector<BenchmarkResult> m_Results;
+};
+
+// Keeps the compiler from discarding a result that is otherwise unused
+template<typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
@@ -0,0 +1,250 @@
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "Benchmark.hpp"
+#include "Camera.hpp"
+#include "ChunkManager.hpp"
+#include "CpuRaytracer.hpp"
+#include "JobSystem.hpp"
+#include "Octree.hpp"
+#include "Palette.hpp"
+#include "Terrain.hpp"
+#include "World.hpp"
+
+struct BenchmarkOptions {
+    uint32_t warmup = 2;
+    uint32_t repetitions = 10;
+    std::string output = "benchmark.json";
+};
+
+// World windows in bricks, each axis a power of two and a multiple of CHUNK_BRICKS
+static const std::array<glm::uvec3, 3> GRID_SIZES = {
+    glm::uvec3(16, 8, 16),
+    glm::uvec3(32, 8, 32),
+    glm::uvec3(64, 16, 64),
+};
+
+static const uint32_t RAY_COUNT = 1 << 16;
+static const uint32_t IMAGE_SIZE = 512;
+static const uint32_t PACK_COUNT = 1 << 20;
+
+static BenchmarkOptions parseOptions(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+        {
+            options.warmup = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--reps") == 0 && hasValue)
+        {
+            options.repetitions = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--output") == 0 && hasValue)
+        {
+            options.output = argv[++i];
+        }
+        else
+        {
+            spdlog::warn("Ignoring unknown argument {}", argv[i]);
+        }
+    }
+
+    return options;
+}
+
+static std::string gridName(glm::uvec3 size)
+{
+    return std::to_string(size.x) + "x" + std::to_string(size.y) + "x" + std::to_string(size.z);
+}
+
+// Generates every chunk in the window and hands it to the world brick by brick, the same path
+// ChunkManager takes without its worker threads. Returns the number of voxels generated.
+static uint64_t fillWorld(World& world, const ChunkGenerator& generator)
+{
+    glm::ivec3 chunkOrigin = world.getGridOrigin() / static_cast<int32_t>(CHUNK_BRICKS);
+    glm::ivec3 chunkCount = glm::ivec3(world.getGridDimensions() / CHUNK_BRICKS);
+
+    std::vector<MaterialIndex> dense(CHUNK_VOXELS);
+    std::vector<MaterialIndex> bricks(CHUNK_VOXELS);
+
+    uint64_t voxels = 0;
+    for (int32_t cy = 0; cy < chunkCount.y; cy++)
+    {
+        for (int32_t cz = 0; cz < chunkCount.z; cz++)
+        {
+            for (int32_t cx = 0; cx < chunkCount.x; cx++)
+            {
+                glm::ivec3 chunkPosition = chunkOrigin + glm::ivec3(cx, cy, cz);
+
+                std::fill(dense.begin(), dense.end(), EMPTY_MATERIAL);
+                generator(chunkPosition, dense);
+                voxels += CHUNK_VOXELS;
+
+                chunkToBricks(dense, bricks);
+
+                const MaterialIndex* brick = bricks.data();
+                for (uint32_t by = 0; by < CHUNK_BRICKS; by++)
+                {
+                    for (uint32_t bz = 0; bz < CHUNK_BRICKS; bz++)
+                    {
+                        for (uint32_t bx = 0; bx < CHUNK_BRICKS; bx++, brick += BRICK_VOXELS)
+                        {
+                            glm::ivec3 brickPosition =
+                                chunkPosition * static_cast<int32_t>(CHUNK_BRICKS) +
+                                glm::ivec3(bx, by, bz);
+                            world.setBrick(brickPosition, brick);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return voxels;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options = parseOptions(argc, argv);
+
+    // World and palette creation log at info level, which would drown out the results
+    spdlog::set_level(spdlog::level::warn);
+
+    BenchmarkRunner runner(options.warmup, options.repetitions);
+
+    JobSystem jobSystem;
+    jobSystem.create();
+
+    {
+        Palette palette;
+        palette.create(VK_NULL_HANDLE);
+        ChunkGenerator generator = createTerrainGenerator(palette);
+
+        std::vector<MaterialIndex> dense(CHUNK_VOXELS);
+        runner.run("terrain/chunk", [&]() -> uint64_t {
+            uint64_t voxels = 0;
+            for (int32_t z = 0; z < 4; z++)
+            {
+                for (int32_t x = 0; x < 4; x++)
+                {
+                    std::fill(dense.begin(), dense.end(), EMPTY_MATERIAL);
+                    generator(glm::ivec3(x, 0, z), dense);
+                    doNotOptimize(dense.data());
+                    voxels += CHUNK_VOXELS;
+                }
+            }
+            return voxels;
+        });
+    }
+
+    {
+        // A fixed set of colours, so the cost is dominated by lookups rather than insertions
+        std::mt19937 random(1);
+        std::uniform_int_distribution<uint32_t> channel(0, 15);
+        std::vector<Voxel> voxels(PACK_COUNT);
+        for (Voxel& voxel : voxels)
+        {
+            voxel.colour = glm::vec4(channel(random), channel(random), channel(random), 15.0f) /
+                           15.0f;
+        }
+
+        runner.run("palette/pack", [&]() -> uint64_t {
+            Palette palette;
+            palette.create(VK_NULL_HANDLE);
+            for (const Voxel& voxel : voxels)
+            {
+                MaterialIndex material = palette.pack(voxel);
+                doNotOptimize(material);
+            }
+            return voxels.size();
+        });
+    }
+
+    for (glm::uvec3 size : GRID_SIZES)
+    {
+        std::string name = gridName(size);
+        uint32_t capacity = size.x * size.y * size.z;
+
+        runner.run("world/fill/" + name, [&]() -> uint64_t {
+            World world;
+            world.create(VK_NULL_HANDLE, size, capacity);
+            ChunkGenerator generator = createTerrainGenerator(world.getPalette());
+            return fillWorld(world, generator);
+        });
+
+        World world;
+        world.create(VK_NULL_HANDLE, size, capacity);
+        fillWorld(world, createTerrainGenerator(world.getPalette()));
+
+        runner.run("octree/build/" + name, [&]() -> uint64_t {
+            Octree octree;
+            octree.build(world);
+            doNotOptimize(octree.getNodes().data());
+            return octree.getNodes().size();
+        });
+
+        runner.run("octree/build_parallel/" + name, [&]() -> uint64_t {
+            Octree octree;
+            octree.build(world, &jobSystem);
+            doNotOptimize(octree.getNodes().data());
+            return octree.getNodes().size();
+        });
+
+        // Rays start above the terrain at random points of the window and head mostly down,
+        // +y points down
+        glm::vec3 dimensions = glm::vec3(world.getDimensions());
+        std::mt19937 random(2);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<std::pair<glm::vec3, glm::vec3>> rays(RAY_COUNT);
+        for (auto& [origin, direction] : rays)
+        {
+            origin = glm::vec3(unit(random) * dimensions.x, 0.5f, unit(random) * dimensions.z);
+            direction = glm::normalize(
+                glm::vec3(unit(random) * 2.0f - 1.0f, 1.0f, unit(random) * 2.0f - 1.0f));
+        }
+
+        float maxDistance = glm::length(dimensions);
+        runner.run("raycast/" + name, [&]() -> uint64_t {
+            uint32_t hits = 0;
+            RaycastHit hit;
+            for (const auto& [origin, direction] : rays)
+            {
+                if (world.raycast(origin, direction, maxDistance, hit)) hits++;
+            }
+            doNotOptimize(hits);
+            return rays.size();
+        });
+
+        // Looking into the window from its front edge and down onto the hills
+        Camera camera(glm::vec3(dimensions.x / 2.0f, 0.0f, -8.0f), 0.0f, -30.0f);
+
+        CpuRaytracer raytracer;
+        raytracer.create(IMAGE_SIZE, IMAGE_SIZE, &jobSystem);
+
+        raytracer.setPacketsEnabled(false);
+        runner.run("cpu_raytracer/scalar/" + name,
+                   [&]() -> uint64_t { return raytracer.render(world, camera); });
+
+        if (CpuRaytracer::hasPacketSupport())
+        {
+            raytracer.setPacketsEnabled(true);
+            runner.run("cpu_raytracer/packet/" + name,
+                       [&]() -> uint64_t { return raytracer.render(world, camera); });
+        }
+    }
+
+    jobSystem.free();
+
+    return runner.writeJson(options.output) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
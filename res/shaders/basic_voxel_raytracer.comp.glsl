@@ -1,15 +1,18 @@
 #version 460
 
 #extension GL_EXT_buffer_reference : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_ballot : require
 
-layout (local_size_x = 16, local_size_y = 16) in;
+// Workgroup size is picked at startup by the autotuner, 16x16 when no specialization is given
+layout (local_size_x = 16, local_size_y = 16, local_size_x_id = 0, local_size_y_id = 1) in;
 
-layout (rgba16f, set = 0, binding = 0) uniform image2D o_Image;
-
-struct Voxel
-{
-    vec4 colour;
-};
+// The draw image, or also swapchain images of another format in the TARGET_ANY_FORMAT build
+#ifdef TARGET_ANY_FORMAT
+layout (set = 0, binding = 0) uniform writeonly image2D o_Image;
+#else
+layout (rgba16f, set = 0, binding = 0) uniform writeonly image2D o_Image;
+#endif
 
 struct Ray
 {
@@ -17,27 +20,16 @@ struct Ray
     vec3 direction;
 };
 
-layout (buffer_reference, std430) readonly buffer VoxelBuffer
-{
-    Voxel voxels[];
-};
+#include "brickmap.glsl"
+#include "reprojection.glsl"
 
-layout (push_constant) uniform constants
-{
-    vec4 p_CameraPosition;
-    vec4 p_CameraForward;
-    vec4 p_CameraRight;
-    vec4 p_CameraUp;
-    uvec3 p_Dimensions;
-    float p_Size;
-    VoxelBuffer p_Voxels;
-};
-
-const vec3 voxelOrigin = vec3(0., 0., 0.);
+// Voxels tested per axis, every ray tests every voxel so only a cube around the camera is
+// traced rather than the whole streamed window
+const int BRUTE_FORCE_EXTENT = 16;
 
 float hit(Ray ray, Voxel voxel, ivec3 position)
 {
-    vec3 center = voxelOrigin + vec3(position) * p_Size;
+    vec3 center = gridOrigin() + vec3(position) * p_Size;
     vec3 minBound = center;
     vec3 maxBound = center + vec3(p_Size);
 
@@ -73,7 +65,9 @@ float hit(Ray ray, Voxel voxel, ivec3 position)
 void main()
 {
     ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
-    ivec2 size = imageSize(o_Image);
+    // Dynamic resolution traces only part of the image, the blit scales it to the window
+    ivec2 size = ivec2(p_Frame.renderExtent);
+    if (texelCoord.x >= size.x || texelCoord.y >= size.y) return;
 
     vec2 uv = vec2(texelCoord) / vec2(size - 1);
 
@@ -89,6 +83,13 @@ void main()
     vec3 target = viewportTopLeft + uv.x * deltaRight + uv.y * deltaDown;
     vec3 direction = normalize(target - origin);
 
+    vec4 cachedColour;
+    if (reuseHit(texelCoord, size, direction, cachedColour))
+    {
+        imageStore(o_Image, texelCoord, cachedColour);
+        return;
+    }
+
     Ray ray;
     ray.origin = origin;
     ray.direction = direction;
@@ -97,14 +98,21 @@ void main()
     Voxel minHitVoxel;
     bool hasHit = false;
 
-    for (int y = 0; y < p_Dimensions.y; y++)
+    // Cube centred on the camera, pushed back inside the grid near its edges
+    ivec3 dimensions = ivec3(p_Dimensions);
+    ivec3 camera = ivec3(floor((origin - gridOrigin()) / p_Size));
+    ivec3 minCorner = clamp(camera - BRUTE_FORCE_EXTENT / 2, ivec3(0),
+                            max(dimensions - BRUTE_FORCE_EXTENT, ivec3(0)));
+    ivec3 maxCorner = min(minCorner + BRUTE_FORCE_EXTENT, dimensions);
+
+    for (int y = minCorner.y; y < maxCorner.y; y++)
     {
-        for (int z = 0; z < p_Dimensions.z; z++)
+        for (int z = minCorner.z; z < maxCorner.z; z++)
         {
-            for (int x = 0; x < p_Dimensions.x; x++)
+            for (int x = minCorner.x; x < maxCorner.x; x++)
             {
-                uint index = x + z * p_Dimensions.x + y * p_Dimensions.x * p_Dimensions.z;
-                Voxel voxel = p_Voxels.voxels[index];
+                Voxel voxel;
+                if (!getVoxel(ivec3(x, y, z), voxel)) continue;
 
                 float hitPos = hit(ray, voxel, ivec3(x, y, z));
 
@@ -119,8 +127,7 @@ void main()
         }
     }
 
-    if (hasHit)
-        imageStore(o_Image, texelCoord, minHitVoxel.colour);
-    else
-        imageStore(o_Image, texelCoord, vec4(0.));
+    vec4 hitColour = hasHit ? minHitVoxel.colour : vec4(0.);
+    storeHit(texelCoord, direction, hasHit, minHit, hitColour);
+    imageStore(o_Image, texelCoord, hitColour);
 }
@@ -0,0 +1,99 @@
+// Brickmap layout and lookups shared by the brickmap raytracers, must match World.hpp
+
+const uint BRICK_SIZE = 8;
+const uint BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+const uint EMPTY_BRICK = 0;
+const uint EMPTY_MATERIAL = 0;
+
+#include "frame.glsl"
+
+struct Voxel
+{
+    vec4 colour;
+};
+
+struct Brick
+{
+    uint occupancy[BRICK_VOXELS / 32];
+    // Two 16 bit material indices per word, even voxels in the low half
+    uint materials[BRICK_VOXELS / 2];
+};
+
+layout (buffer_reference, std430) readonly buffer BrickPool
+{
+    Brick bricks[];
+};
+
+layout (buffer_reference, std430) readonly buffer BrickGrid
+{
+    uint bricks[];
+};
+
+layout (buffer_reference, std430) readonly buffer Palette
+{
+    vec4 colours[];
+};
+
+layout (push_constant) uniform constants
+{
+    vec4 p_CameraPosition;
+    vec4 p_CameraForward;
+    vec4 p_CameraRight;
+    vec4 p_CameraUp;
+    uvec3 p_Dimensions;
+    float p_Size;
+    // World position of the grid's minimum corner in voxels, the grid wraps around it
+    ivec4 p_GridOrigin;
+    BrickPool p_BrickPool;
+    Palette p_Palette;
+    BrickGrid p_BrickGrid;
+    FrameUniforms p_Frame;
+};
+
+vec3 gridOrigin()
+{
+    return vec3(p_GridOrigin.xyz) * p_Size;
+}
+
+ivec3 gridDimensions()
+{
+    return (ivec3(p_Dimensions) + int(BRICK_SIZE) - 1) / int(BRICK_SIZE);
+}
+
+// Takes a brick position relative to the grid origin and returns the pool index of the brick
+// offset by one, or EMPTY_BRICK. Grid dimensions are powers of two so the wrap is a mask.
+uint getBrick(ivec3 gridPosition)
+{
+    ivec3 dimensions = gridDimensions();
+    ivec3 wrapped = (gridPosition + p_GridOrigin.xyz / int(BRICK_SIZE)) & (dimensions - 1);
+    return p_BrickGrid.bricks[wrapped.x + wrapped.z * dimensions.x + wrapped.y * dimensions.x * dimensions.z];
+}
+
+uint brickVoxelIndex(ivec3 localPosition)
+{
+    uvec3 local = uvec3(localPosition);
+    return local.x + local.z * BRICK_SIZE + local.y * BRICK_SIZE * BRICK_SIZE;
+}
+
+bool brickVoxelSolid(uint brick, uint index)
+{
+    return (p_BrickPool.bricks[brick - 1].occupancy[index / 32] & (1u << (index % 32))) != 0;
+}
+
+uint brickVoxelMaterial(uint brick, uint index)
+{
+    uint word = p_BrickPool.bricks[brick - 1].materials[index / 2];
+    return (word >> ((index % 2) * 16)) & 0xFFFFu;
+}
+
+bool getVoxel(ivec3 position, out Voxel voxel)
+{
+    uint brick = getBrick(position / int(BRICK_SIZE));
+    if (brick == EMPTY_BRICK) return false;
+
+    uint index = brickVoxelIndex(position % int(BRICK_SIZE));
+    if (!brickVoxelSolid(brick, index)) return false;
+
+    voxel.colour = p_Palette.colours[brickVoxelMaterial(brick, index)];
+    return true;
+}
@@ -0,0 +1,160 @@
+#version 460
+
+#extension GL_EXT_buffer_reference : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+// Workgroup size is picked at startup by the autotuner, 16x16 when no specialization is given
+layout (local_size_x = 16, local_size_y = 16, local_size_x_id = 0, local_size_y_id = 1) in;
+
+// The draw image, or also swapchain images of another format in the TARGET_ANY_FORMAT build
+#ifdef TARGET_ANY_FORMAT
+layout (set = 0, binding = 0) uniform writeonly image2D o_Image;
+#else
+layout (rgba16f, set = 0, binding = 0) uniform writeonly image2D o_Image;
+#endif
+
+struct Ray
+{
+    vec3 origin;
+    vec3 direction;
+};
+
+#include "brickmap.glsl"
+#include "reprojection.glsl"
+#include "coarse_depth.glsl"
+
+vec2 intersect(Ray ray, vec3 invDir, vec3 minBound, vec3 maxBound)
+{
+    vec3 t1 = (minBound - ray.origin) * invDir;
+    vec3 t2 = (maxBound - ray.origin) * invDir;
+
+    vec3 tMin = min(t1, t2);
+    vec3 tMax = max(t1, t2);
+
+    return vec2(max(max(tMin.x, tMin.y), tMin.z), min(min(tMax.x, tMax.y), tMax.z));
+}
+
+// Distance along the ray to the first boundary crossed on each axis from the given cell
+vec3 firstBoundary(Ray ray, vec3 invDir, ivec3 stepDir, vec3 gridMin, ivec3 cell, float cellSize)
+{
+    vec3 nextBoundary = gridMin + (vec3(cell) + vec3(max(stepDir, ivec3(0)))) * cellSize;
+    return mix(vec3(1e30), (nextBoundary - ray.origin) * invDir, notEqual(stepDir, ivec3(0)));
+}
+
+// Moves the cell across its nearest boundary and returns the distance that boundary lies at
+float stepCell(inout ivec3 cell, inout vec3 tMax, vec3 tDelta, ivec3 stepDir)
+{
+    float t;
+    if (tMax.x < tMax.y && tMax.x < tMax.z)
+    {
+        t = tMax.x;
+        cell.x += stepDir.x;
+        tMax.x += tDelta.x;
+    }
+    else if (tMax.y < tMax.z)
+    {
+        t = tMax.y;
+        cell.y += stepDir.y;
+        tMax.y += tDelta.y;
+    }
+    else
+    {
+        t = tMax.z;
+        cell.z += stepDir.z;
+        tMax.z += tDelta.z;
+    }
+    return t;
+}
+
+void main()
+{
+    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    // Dynamic resolution traces only part of the image, the blit scales it to the window
+    ivec2 size = ivec2(p_Frame.renderExtent);
+    if (texelCoord.x >= size.x || texelCoord.y >= size.y) return;
+
+    vec2 uv = vec2(texelCoord) / vec2(size - 1);
+
+    const float viewportWidth = 2.0;
+    const float viewportHeight = 2.0;
+    const float viewportDepth = 1.0;
+
+    vec3 viewportTopLeft = vec3(p_CameraPosition + viewportDepth * p_CameraForward - (p_CameraRight * viewportWidth / 2.) + (p_CameraUp * viewportHeight / 2.));
+    vec3 deltaRight = vec3(p_CameraRight * viewportWidth);
+    vec3 deltaDown = vec3(-p_CameraUp * viewportHeight);
+
+    vec3 origin = vec3(p_CameraPosition);
+    vec3 target = viewportTopLeft + uv.x * deltaRight + uv.y * deltaDown;
+    vec3 direction = normalize(target - origin);
+
+    vec4 cachedColour;
+    if (reuseHit(texelCoord, size, direction, cachedColour))
+    {
+        imageStore(o_Image, texelCoord, cachedColour);
+        return;
+    }
+
+    Ray ray;
+    ray.origin = origin;
+    ray.direction = direction;
+
+    vec3 invDir = 1. / ray.direction;
+    ivec3 stepDir = ivec3(sign(ray.direction));
+
+    ivec3 bricks = gridDimensions();
+    float brickWorldSize = p_Size * float(BRICK_SIZE);
+
+    vec4 hitColour = vec4(0.);
+    bool hasHit = false;
+    float hitDistance = 0.;
+
+    // Nothing in the pixel's tile is hit before the prepass distance
+    float tStart = coarseDistance(texelCoord);
+
+    vec2 gridHit = intersect(ray, invDir, gridOrigin(), gridOrigin() + vec3(bricks) * brickWorldSize);
+    if (gridHit.y >= max(gridHit.x, tStart))
+    {
+        float t = max(gridHit.x, tStart);
+        vec3 entry = ray.origin + ray.direction * t;
+
+        ivec3 brickCell = clamp(ivec3(floor((entry - gridOrigin()) / brickWorldSize)), ivec3(0), bricks - 1);
+        vec3 brickDelta = abs(vec3(brickWorldSize) * invDir);
+        vec3 brickMax = firstBoundary(ray, invDir, stepDir, gridOrigin(), brickCell, brickWorldSize);
+
+        while (!hasHit && all(greaterThanEqual(brickCell, ivec3(0))) && all(lessThan(brickCell, bricks)))
+        {
+            // Empty bricks are skipped with a single lookup
+            uint brick = getBrick(brickCell);
+            if (brick != EMPTY_BRICK)
+            {
+                vec3 brickMin = gridOrigin() + vec3(brickCell) * brickWorldSize;
+                vec3 brickEntry = ray.origin + ray.direction * t;
+
+                ivec3 cell = clamp(ivec3(floor((brickEntry - brickMin) / p_Size)), ivec3(0), ivec3(BRICK_SIZE - 1));
+                vec3 tDelta = abs(vec3(p_Size) * invDir);
+                vec3 tMax = firstBoundary(ray, invDir, stepDir, brickMin, cell, p_Size);
+
+                while (all(greaterThanEqual(cell, ivec3(0))) && all(lessThan(cell, ivec3(BRICK_SIZE))))
+                {
+                    uint index = brickVoxelIndex(cell);
+                    if (brickVoxelSolid(brick, index))
+                    {
+                        vec3 cellMin = brickMin + vec3(cell) * p_Size;
+                        hitColour = p_Palette.colours[brickVoxelMaterial(brick, index)];
+                        hitDistance = max(intersect(ray, invDir, cellMin, cellMin + vec3(p_Size)).x, 0.);
+                        hasHit = true;
+                        break;
+                    }
+
+                    stepCell(cell, tMax, tDelta, stepDir);
+                }
+            }
+
+            t = stepCell(brickCell, brickMax, brickDelta, stepDir);
+        }
+    }
+
+    storeHit(texelCoord, direction, hasHit, hitDistance, hitColour);
+    imageStore(o_Image, texelCoord, hitColour);
+}
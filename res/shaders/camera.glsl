@@ -0,0 +1,19 @@
+// Primary ray directions of the raytracers' pinhole camera, 2 units wide and high at depth 1
+
+vec3 cameraRay(vec2 uv, vec3 forward, vec3 right, vec3 up)
+{
+    return normalize(forward + (uv.x * 2. - 1.) * right + (1. - uv.y * 2.) * up);
+}
+
+// Inverse of cameraRay in pixels, false for points behind the camera
+bool cameraProject(vec3 position, vec3 origin, vec3 forward, vec3 right, vec3 up, ivec2 size,
+                   out vec2 pixel)
+{
+    vec3 view = position - origin;
+    float depth = dot(view, forward);
+    if (depth <= 1e-4) return false;
+
+    vec2 uv = vec2(depth + dot(view, right), depth - dot(view, up)) / (2. * depth);
+    pixel = uv * vec2(size - 1);
+    return true;
+}
@@ -0,0 +1,12 @@
+// Per-tile start distances written by the depth prepass, must match Engine.hpp
+
+const int COARSE_TILE_SIZE = 8;
+
+layout (r32f, set = 0, binding = 1) uniform image2D o_CoarseDepth;
+
+// Distance no ray of the pixel's tile hits anything before, 0 without a prepass
+float coarseDistance(ivec2 texelCoord)
+{
+    if (p_Frame.coarseDepth == 0) return 0.;
+    return imageLoad(o_CoarseDepth, texelCoord / COARSE_TILE_SIZE).x;
+}
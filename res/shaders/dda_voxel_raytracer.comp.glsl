@@ -0,0 +1,137 @@
+#version 460
+
+#extension GL_EXT_buffer_reference : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+// Workgroup size is picked at startup by the autotuner, 16x16 when no specialization is given
+layout (local_size_x = 16, local_size_y = 16, local_size_x_id = 0, local_size_y_id = 1) in;
+
+// The draw image, or also swapchain images of another format in the TARGET_ANY_FORMAT build
+#ifdef TARGET_ANY_FORMAT
+layout (set = 0, binding = 0) uniform writeonly image2D o_Image;
+#else
+layout (rgba16f, set = 0, binding = 0) uniform writeonly image2D o_Image;
+#endif
+
+struct Ray
+{
+    vec3 origin;
+    vec3 direction;
+};
+
+#include "brickmap.glsl"
+#include "reprojection.glsl"
+#include "coarse_depth.glsl"
+
+vec2 intersect(Ray ray, vec3 invDir, vec3 minBound, vec3 maxBound)
+{
+    vec3 t1 = (minBound - ray.origin) * invDir;
+    vec3 t2 = (maxBound - ray.origin) * invDir;
+
+    vec3 tMin = min(t1, t2);
+    vec3 tMax = max(t1, t2);
+
+    return vec2(max(max(tMin.x, tMin.y), tMin.z), min(min(tMax.x, tMax.y), tMax.z));
+}
+
+void main()
+{
+    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    // Dynamic resolution traces only part of the image, the blit scales it to the window
+    ivec2 size = ivec2(p_Frame.renderExtent);
+    if (texelCoord.x >= size.x || texelCoord.y >= size.y) return;
+
+    vec2 uv = vec2(texelCoord) / vec2(size - 1);
+
+    const float viewportWidth = 2.0;
+    const float viewportHeight = 2.0;
+    const float viewportDepth = 1.0;
+
+    vec3 viewportTopLeft = vec3(p_CameraPosition + viewportDepth * p_CameraForward - (p_CameraRight * viewportWidth / 2.) + (p_CameraUp * viewportHeight / 2.));
+    vec3 deltaRight = vec3(p_CameraRight * viewportWidth);
+    vec3 deltaDown = vec3(-p_CameraUp * viewportHeight);
+
+    vec3 origin = vec3(p_CameraPosition);
+    vec3 target = viewportTopLeft + uv.x * deltaRight + uv.y * deltaDown;
+    vec3 direction = normalize(target - origin);
+
+    vec4 cachedColour;
+    if (reuseHit(texelCoord, size, direction, cachedColour))
+    {
+        imageStore(o_Image, texelCoord, cachedColour);
+        return;
+    }
+
+    Ray ray;
+    ray.origin = origin;
+    ray.direction = direction;
+
+    vec3 invDir = 1. / ray.direction;
+    ivec3 dimensions = ivec3(p_Dimensions);
+
+    vec4 hitColour = vec4(0.);
+    bool hasHit = false;
+    float hitDistance = 0.;
+
+    // Nothing in the pixel's tile is hit before the prepass distance
+    float tStart = coarseDistance(texelCoord);
+
+    // Clip the ray to the grid so stepping starts at the first cell it touches
+    vec2 gridHit = intersect(ray, invDir, gridOrigin(), gridOrigin() + vec3(dimensions) * p_Size);
+    if (gridHit.y >= max(gridHit.x, tStart))
+    {
+        float tEnter = max(gridHit.x, tStart);
+        vec3 entry = ray.origin + ray.direction * tEnter;
+
+        ivec3 cell = clamp(ivec3(floor((entry - gridOrigin()) / p_Size)), ivec3(0), dimensions - 1);
+        ivec3 stepDir = ivec3(sign(ray.direction));
+
+        vec3 tDelta = abs(vec3(p_Size) * invDir);
+        vec3 nextBoundary = gridOrigin() + (vec3(cell) + vec3(max(stepDir, ivec3(0)))) * p_Size;
+        vec3 tMax = mix(vec3(1e30), (nextBoundary - ray.origin) * invDir, notEqual(stepDir, ivec3(0)));
+
+        while (all(greaterThanEqual(cell, ivec3(0))) && all(lessThan(cell, dimensions)))
+        {
+            Voxel voxel;
+            if (getVoxel(cell, voxel))
+            {
+                vec3 cellMin = gridOrigin() + vec3(cell) * p_Size;
+                hitColour = voxel.colour;
+                hitDistance = max(intersect(ray, invDir, cellMin, cellMin + vec3(p_Size)).x, 0.);
+                hasHit = true;
+                break;
+            }
+
+            if (tMax.x < tMax.y)
+            {
+                if (tMax.x < tMax.z)
+                {
+                    cell.x += stepDir.x;
+                    tMax.x += tDelta.x;
+                }
+                else
+                {
+                    cell.z += stepDir.z;
+                    tMax.z += tDelta.z;
+                }
+            }
+            else
+            {
+                if (tMax.y < tMax.z)
+                {
+                    cell.y += stepDir.y;
+                    tMax.y += tDelta.y;
+                }
+                else
+                {
+                    cell.z += stepDir.z;
+                    tMax.z += tDelta.z;
+                }
+            }
+        }
+    }
+
+    storeHit(texelCoord, direction, hasHit, hitDistance, hitColour);
+    imageStore(o_Image, texelCoord, hitColour);
+}
@@ -0,0 +1,94 @@
+#version 460
+
+#extension GL_EXT_buffer_reference : enable
+#extension GL_GOOGLE_include_directive : require
+
+// One invocation per tile of COARSE_TILE_SIZE pixels squared
+layout (local_size_x = 8, local_size_y = 8, local_size_x_id = 0, local_size_y_id = 1) in;
+
+#include "brickmap.glsl"
+#include "camera.glsl"
+#include "coarse_depth.glsl"
+
+// Tiles that have not reached anything after this many steps start their rays where they stopped
+const int MAX_STEPS = 256;
+// Boxes wider than this many bricks count as occupied instead of being searched
+const int MAX_BOX_BRICKS = 4;
+
+// Whether any non-empty brick overlaps the box, positions relative to the grid origin
+bool boxOccupied(vec3 center, float halfSize)
+{
+    float brickWorldSize = p_Size * float(BRICK_SIZE);
+    ivec3 bricks = gridDimensions();
+
+    ivec3 minBrick = max(ivec3(floor((center - halfSize) / brickWorldSize)), ivec3(0));
+    ivec3 maxBrick = min(ivec3(floor((center + halfSize) / brickWorldSize)), bricks - 1);
+    if (any(greaterThanEqual(maxBrick - minBrick, ivec3(MAX_BOX_BRICKS)))) return true;
+
+    for (int y = minBrick.y; y <= maxBrick.y; y++)
+    {
+        for (int z = minBrick.z; z <= maxBrick.z; z++)
+        {
+            for (int x = minBrick.x; x <= maxBrick.x; x++)
+            {
+                if (getBrick(ivec3(x, y, z)) != EMPTY_BRICK) return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Marches a cone holding every pixel ray of the tile through the brick grid. Each step checks a
+// box around the part of the cone between t and t + step, so the first occupied box gives a
+// distance no ray of the tile can hit anything before.
+void main()
+{
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(p_Frame.renderExtent);
+    ivec2 tiles = (size + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE;
+    if (tile.x >= tiles.x || tile.y >= tiles.y) return;
+
+    vec3 forward = vec3(p_CameraForward);
+    vec3 right = vec3(p_CameraRight);
+    vec3 up = vec3(p_CameraUp);
+
+    // The last tile of a row or column can be partial
+    vec2 first = vec2(tile * COARSE_TILE_SIZE);
+    vec2 last = vec2(min(tile * COARSE_TILE_SIZE + COARSE_TILE_SIZE - 1, size - 1));
+    vec2 toUv = 1. / vec2(size - 1);
+    vec3 axis = cameraRay((first + last) * 0.5 * toUv, forward, right, up);
+
+    // The corner rays are the furthest from the axis, padded against rounding
+    float cosAngle = 1.;
+    cosAngle = min(cosAngle, dot(axis, cameraRay(first * toUv, forward, right, up)));
+    cosAngle = min(cosAngle, dot(axis, cameraRay(vec2(last.x, first.y) * toUv, forward, right, up)));
+    cosAngle = min(cosAngle, dot(axis, cameraRay(vec2(first.x, last.y) * toUv, forward, right, up)));
+    cosAngle = min(cosAngle, dot(axis, cameraRay(last * toUv, forward, right, up)));
+    float tanAngle = sqrt(max(1. - cosAngle * cosAngle, 0.)) / cosAngle * 1.01 + 1e-4;
+
+    vec3 origin = vec3(p_CameraPosition) - gridOrigin();
+    float brickWorldSize = p_Size * float(BRICK_SIZE);
+
+    // No point of the grid is further along the axis than its furthest corner
+    vec3 gridSize = vec3(gridDimensions()) * brickWorldSize;
+    float gridFar = length(max(abs(origin), abs(origin - gridSize)));
+
+    float t = 0.;
+    for (int i = 0; i < MAX_STEPS; i++)
+    {
+        if (t > gridFar)
+        {
+            // Every ray of the tile leaves the grid without a hit
+            t = 1e30;
+            break;
+        }
+
+        float step = brickWorldSize * 0.5 + t * tanAngle;
+        float halfSize = step * 0.5 + (t + step) * tanAngle;
+        if (boxOccupied(origin + axis * (t + step * 0.5), halfSize)) break;
+
+        t += step;
+    }
+
+    imageStore(o_CoarseDepth, tile, vec4(t));
+}
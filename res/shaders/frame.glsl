@@ -0,0 +1,30 @@
+// Per-frame data pushed through the frame allocator, must match FrameUniforms in Engine.hpp
+
+layout (buffer_reference, std430) buffer RayCounter
+{
+    uint traced;
+};
+
+layout (buffer_reference, std430) readonly buffer FrameUniforms
+{
+    uint frameNumber;
+    float frameDelta;
+    // Region of the draw image traced this frame, from the top left corner
+    uvec2 renderExtent;
+    // Camera the temporal cache's history was traced with
+    vec4 previousCameraPosition;
+    vec4 previousCameraForward;
+    vec4 previousCameraRight;
+    vec4 previousCameraUp;
+    RayCounter rayCounter;
+    uint historyValid;
+    // Whether the depth prepass ran for this frame's scene
+    uint coarseDepth;
+    // Box in voxels the scene changed in since the history was traced, empty when min > max
+    vec4 changedMin;
+    vec4 changedMax;
+    // Region the history was traced at
+    uvec2 previousExtent;
+    // Bindless heap slot of the octree nodes
+    uint octreeSlot;
+};
@@ -0,0 +1,20 @@
+#version 460
+
+#extension GL_EXT_buffer_reference : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+// One invocation per pixel of last frame's history
+layout (local_size_x = 8, local_size_y = 8, local_size_x_id = 0, local_size_y_id = 1) in;
+
+#include "brickmap.glsl"
+#include "reprojection.glsl"
+
+void main()
+{
+    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 previousSize = ivec2(p_Frame.previousExtent);
+    if (texelCoord.x >= previousSize.x || texelCoord.y >= previousSize.y) return;
+
+    splatOccluder(texelCoord, ivec2(p_Frame.renderExtent));
+}
@@ -0,0 +1,201 @@
+#version 460
+
+#extension GL_EXT_buffer_reference : enable
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+// Workgroup size is picked at startup by the autotuner, 16x16 when no specialization is given
+layout (local_size_x = 16, local_size_y = 16, local_size_x_id = 0, local_size_y_id = 1) in;
+
+// The draw image, or also swapchain images of another format in the TARGET_ANY_FORMAT build
+#ifdef TARGET_ANY_FORMAT
+layout (set = 0, binding = 0) uniform writeonly image2D o_Image;
+#else
+layout (rgba16f, set = 0, binding = 0) uniform writeonly image2D o_Image;
+#endif
+
+struct OctreeNode
+{
+    uint childMask;
+    uint data;
+};
+
+struct Ray
+{
+    vec3 origin;
+    vec3 direction;
+};
+
+// The bindless heap's buffers, the octree is in the slot FrameUniforms names
+layout (set = 1, binding = 0, std430) readonly buffer OctreeBuffer
+{
+    OctreeNode nodes[];
+} b_Buffers[];
+
+#include "frame.glsl"
+
+layout (buffer_reference, std430) readonly buffer Palette
+{
+    vec4 colours[];
+};
+
+layout (push_constant) uniform constants
+{
+    vec4 p_CameraPosition;
+    vec4 p_CameraForward;
+    vec4 p_CameraRight;
+    vec4 p_CameraUp;
+    uvec3 p_Dimensions;
+    float p_Size;
+    // World position of the octree's minimum corner in voxels
+    ivec4 p_GridOrigin;
+    // After the brick pool address the other raytracers use
+    layout (offset = 104) Palette p_Palette;
+    // After the brick grid address the other raytracers use
+    layout (offset = 120) FrameUniforms p_Frame;
+};
+
+#include "reprojection.glsl"
+#include "coarse_depth.glsl"
+
+vec3 gridOrigin()
+{
+    return vec3(p_GridOrigin.xyz) * p_Size;
+}
+
+const int MAX_DEPTH = 12;
+// Every level pushes at most 7 siblings before descending into the nearest child
+const int STACK_SIZE = MAX_DEPTH * 7 + 1;
+
+vec2 intersect(Ray ray, vec3 invDir, vec3 minBound, vec3 maxBound)
+{
+    vec3 t1 = (minBound - ray.origin) * invDir;
+    vec3 t2 = (maxBound - ray.origin) * invDir;
+
+    vec3 tMin = min(t1, t2);
+    vec3 tMax = max(t1, t2);
+
+    return vec2(max(max(tMin.x, tMin.y), tMin.z), min(min(tMax.x, tMax.y), tMax.z));
+}
+
+ivec3 childOffset(uint child)
+{
+    return ivec3(child & 1u, (child >> 1) & 1u, (child >> 2) & 1u);
+}
+
+void main()
+{
+    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    // Dynamic resolution traces only part of the image, the blit scales it to the window
+    ivec2 size = ivec2(p_Frame.renderExtent);
+    if (texelCoord.x >= size.x || texelCoord.y >= size.y) return;
+
+    vec2 uv = vec2(texelCoord) / vec2(size - 1);
+
+    const float viewportWidth = 2.0;
+    const float viewportHeight = 2.0;
+    const float viewportDepth = 1.0;
+
+    vec3 viewportTopLeft = vec3(p_CameraPosition + viewportDepth * p_CameraForward - (p_CameraRight * viewportWidth / 2.) + (p_CameraUp * viewportHeight / 2.));
+    vec3 deltaRight = vec3(p_CameraRight * viewportWidth);
+    vec3 deltaDown = vec3(-p_CameraUp * viewportHeight);
+
+    vec3 origin = vec3(p_CameraPosition);
+    vec3 target = viewportTopLeft + uv.x * deltaRight + uv.y * deltaDown;
+    vec3 direction = normalize(target - origin);
+
+    vec4 cachedColour;
+    if (reuseHit(texelCoord, size, direction, cachedColour))
+    {
+        imageStore(o_Image, texelCoord, cachedColour);
+        return;
+    }
+
+    Ray ray;
+    ray.origin = origin;
+    ray.direction = direction;
+
+    vec3 invDir = 1. / ray.direction;
+
+    uint maxDimension = max(max(max(p_Dimensions.x, p_Dimensions.y), p_Dimensions.z), 2u);
+    int octreeSize = 1 << (findMSB(maxDimension - 1u) + 1);
+
+    // x, y, z: cell origin in voxels, w: cell size in voxels
+    uint stackNode[STACK_SIZE];
+    ivec4 stackCell[STACK_SIZE];
+    int stackPtr = 0;
+
+    // Nodes the ray leaves before the prepass distance cannot hold its hit
+    float tStart = coarseDistance(texelCoord);
+    uint octree = p_Frame.octreeSlot;
+
+    vec2 rootHit = intersect(ray, invDir, gridOrigin(), gridOrigin() + vec3(octreeSize) * p_Size);
+    if (rootHit.y >= max(rootHit.x, tStart) && b_Buffers[octree].nodes[0].childMask != 0)
+    {
+        stackNode[0] = 0;
+        stackCell[0] = ivec4(0, 0, 0, octreeSize);
+        stackPtr = 1;
+    }
+
+    vec4 hitColour = vec4(0.);
+    bool hasHit = false;
+    float hitDistance = 0.;
+
+    while (stackPtr > 0)
+    {
+        stackPtr--;
+        OctreeNode node = b_Buffers[octree].nodes[stackNode[stackPtr]];
+        ivec4 cell = stackCell[stackPtr];
+
+        if (cell.w == 1)
+        {
+            // Children are pushed far to near, so the first leaf reached is the closest hit
+            vec3 leafMin = gridOrigin() + vec3(cell.xyz) * p_Size;
+            hitColour = p_Palette.colours[node.data];
+            hitDistance = max(intersect(ray, invDir, leafMin, leafMin + vec3(p_Size)).x, 0.);
+            hasHit = true;
+            break;
+        }
+
+        int halfSize = cell.w / 2;
+
+        float childEntry[8];
+        uint childSlot[8];
+        int childCount = 0;
+
+        for (uint i = 0; i < 8; i++)
+        {
+            if ((node.childMask & (1u << i)) == 0) continue;
+
+            vec3 minBound = gridOrigin() + vec3(cell.xyz + childOffset(i) * halfSize) * p_Size;
+            vec2 t = intersect(ray, invDir, minBound, minBound + vec3(halfSize) * p_Size);
+            if (t.y < max(t.x, tStart)) continue;
+
+            // Sort by descending entry distance
+            int j = childCount;
+            while (j > 0 && childEntry[j - 1] < t.x)
+            {
+                childEntry[j] = childEntry[j - 1];
+                childSlot[j] = childSlot[j - 1];
+                j--;
+            }
+            childEntry[j] = t.x;
+            childSlot[j] = i;
+            childCount++;
+        }
+
+        for (int k = 0; k < childCount; k++)
+        {
+            uint child = childSlot[k];
+            uint rank = bitCount(node.childMask & ((1u << child) - 1u));
+
+            stackNode[stackPtr] = node.data + rank;
+            stackCell[stackPtr] = ivec4(cell.xyz + childOffset(child) * halfSize, halfSize);
+            stackPtr++;
+        }
+    }
+
+    storeHit(texelCoord, direction, hasHit, hitDistance, hitColour);
+    imageStore(o_Image, texelCoord, hitColour);
+}
@@ -0,0 +1,157 @@
+// Reuse of last frame's primary hits, must match TemporalCache.hpp
+//
+// A pixel guesses its hit distance from last frame's hit at the same texel, projects that point
+// into the previous camera and reads the hit stored there. The hit is reused when it projects
+// back onto this pixel, this pixel's ray reaches the same voxel at that distance, nothing last
+// frame saw in front of it has been splatted onto this pixel, and the ray does not pass through
+// the region the scene changed in. Misses, disoccluded, newly occluded and changed pixels and a
+// rotating subset of pixels are traced again. The history may have been traced at another
+// extent, texels are matched through their position in the image.
+
+#include "camera.glsl"
+
+layout (rgba32ui, set = 2, binding = 0) uniform readonly uimage2D h_Previous;
+layout (rgba32ui, set = 2, binding = 1) uniform writeonly uimage2D h_Current;
+layout (r32ui, set = 2, binding = 2) uniform uimage2D h_Occluders;
+
+// Every pixel is traced at least once every REFRESH_PERIOD frames
+const uint REFRESH_PERIOD = 8;
+const uint NO_VOXEL = 0xFFFFFFFFu;
+// Fraction of a voxel a hit point is pushed along its ray to land inside the voxel
+const float HIT_BIAS = 1e-3;
+// How much nearer than a hit, relative to its distance and in voxels, a splatted hit has to be
+// to occlude it. Neighbouring hits on the same slanted surface land on the pixel too.
+const float OCCLUDER_SLACK = 0.05;
+const float OCCLUDER_VOXELS = 2.;
+
+// World voxel coordinates wrapped to 11, 10 and 11 bits, enough to tell neighbours apart
+uint voxelId(vec3 position)
+{
+    uvec3 voxel = uvec3(ivec3(floor(position / p_Size)));
+    return (voxel.x & 0x7FFu) | ((voxel.y & 0x3FFu) << 11) | ((voxel.z & 0x7FFu) << 21);
+}
+
+// Whether the segment from the camera to the point crosses the changed region
+bool crossesChange(vec3 origin, vec3 position)
+{
+    vec3 boxMin = p_Frame.changedMin.xyz * p_Size;
+    vec3 boxMax = p_Frame.changedMax.xyz * p_Size;
+    if (any(greaterThan(boxMin, boxMax))) return false;
+
+    vec3 inverse = 1. / (position - origin);
+    vec3 t0 = (boxMin - origin) * inverse;
+    vec3 t1 = (boxMax - origin) * inverse;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float entry = max(max(tNear.x, tNear.y), max(tNear.z, 0.));
+    float exit = min(min(tFar.x, tFar.y), min(tFar.z, 1.));
+    return entry <= exit;
+}
+
+bool reuseHit(ivec2 texelCoord, ivec2 size, vec3 direction, out vec4 colour)
+{
+    if (p_Frame.historyValid == 0) return false;
+
+    uint refreshSlot = (uint(texelCoord.x) & 3u) | ((uint(texelCoord.y) & 1u) << 2);
+    if (refreshSlot == p_Frame.frameNumber % REFRESH_PERIOD) return false;
+
+    vec3 origin = vec3(p_CameraPosition);
+    vec3 previousOrigin = vec3(p_Frame.previousCameraPosition);
+    vec3 previousForward = vec3(p_Frame.previousCameraForward);
+    vec3 previousRight = vec3(p_Frame.previousCameraRight);
+    vec3 previousUp = vec3(p_Frame.previousCameraUp);
+
+    ivec2 previousSize = ivec2(p_Frame.previousExtent);
+    vec2 uv = vec2(texelCoord) / vec2(size - 1);
+    uvec4 guess = imageLoad(h_Previous, ivec2(round(uv * vec2(previousSize - 1))));
+    if (guess.y == NO_VOXEL) return false;
+
+    vec2 previousPixel;
+    vec3 guessPosition = origin + direction * uintBitsToFloat(guess.x);
+    if (!cameraProject(guessPosition, previousOrigin, previousForward, previousRight, previousUp,
+                       previousSize, previousPixel))
+        return false;
+
+    ivec2 previousTexel = ivec2(round(previousPixel));
+    if (any(lessThan(previousTexel, ivec2(0))) ||
+        any(greaterThanEqual(previousTexel, previousSize)))
+        return false;
+
+    uvec4 history = imageLoad(h_Previous, previousTexel);
+    if (history.y == NO_VOXEL) return false;
+
+    vec2 previousUv = vec2(previousTexel) / vec2(previousSize - 1);
+    vec3 hitPosition = previousOrigin + uintBitsToFloat(history.x) *
+                       cameraRay(previousUv, previousForward, previousRight, previousUp);
+
+    // Something else covers this pixel now, or the hit was seen from elsewhere
+    vec2 pixel;
+    if (!cameraProject(hitPosition, origin, vec3(p_CameraForward), vec3(p_CameraRight),
+                       vec3(p_CameraUp), size, pixel))
+        return false;
+    if (any(greaterThan(abs(pixel - vec2(texelCoord)), vec2(0.5)))) return false;
+
+    // Something seen last frame has moved in front of the hit
+    float distance = length(hitPosition - origin);
+    float occluder = uintBitsToFloat(imageLoad(h_Occluders, texelCoord).x);
+    if (occluder < distance * (1. - OCCLUDER_SLACK) - OCCLUDER_VOXELS * p_Size) return false;
+
+    // Near voxel edges this pixel's ray can pass the voxel the previous ray hit
+    vec3 voxelPosition = origin + direction * (distance + HIT_BIAS * p_Size);
+    if (voxelId(voxelPosition) != history.y) return false;
+
+    // The hit voxel, or something in front of it, was edited or streamed in or out
+    if (crossesChange(origin, voxelPosition)) return false;
+
+    colour = vec4(unpackHalf2x16(history.z), unpackHalf2x16(history.w));
+    imageStore(h_Current, texelCoord, uvec4(floatBitsToUint(distance), history.yzw));
+    return true;
+}
+
+// Moves last frame's hit at the texel to where it lands this frame, into the 2x2 pixels around
+// it so magnification leaves fewer holes, keeping the nearest distance per pixel. The texel is
+// in the previous extent, size is this frame's.
+void splatOccluder(ivec2 texelCoord, ivec2 size)
+{
+    uvec4 history = imageLoad(h_Previous, texelCoord);
+    if (history.y == NO_VOXEL) return;
+
+    vec2 previousUv = vec2(texelCoord) / vec2(ivec2(p_Frame.previousExtent) - 1);
+    vec3 hitPosition = vec3(p_Frame.previousCameraPosition) + uintBitsToFloat(history.x) *
+                       cameraRay(previousUv, vec3(p_Frame.previousCameraForward),
+                                 vec3(p_Frame.previousCameraRight),
+                                 vec3(p_Frame.previousCameraUp));
+
+    vec3 origin = vec3(p_CameraPosition);
+    vec2 pixel;
+    if (!cameraProject(hitPosition, origin, vec3(p_CameraForward), vec3(p_CameraRight),
+                       vec3(p_CameraUp), size, pixel))
+        return;
+
+    uint distance = floatBitsToUint(length(hitPosition - origin));
+    ivec2 corner = ivec2(floor(pixel));
+    for (int y = 0; y <= 1; y++)
+    {
+        for (int x = 0; x <= 1; x++)
+        {
+            ivec2 target = corner + ivec2(x, y);
+            if (any(lessThan(target, ivec2(0))) || any(greaterThanEqual(target, size))) continue;
+
+            imageAtomicMin(h_Occluders, target, distance);
+        }
+    }
+}
+
+// Keeps a traced hit for the next frame and counts the ray, distance is ignored on a miss
+void storeHit(ivec2 texelCoord, vec3 direction, bool hit, float distance, vec4 colour)
+{
+    vec3 position = vec3(p_CameraPosition) + direction * (distance + HIT_BIAS * p_Size);
+    uint id = hit ? voxelId(position) : NO_VOXEL;
+    imageStore(h_Current, texelCoord,
+               uvec4(floatBitsToUint(distance), id, packHalf2x16(colour.rg),
+                     packHalf2x16(colour.ba)));
+
+    // One atomic per subgroup
+    uint traced = subgroupBallotBitCount(subgroupBallot(true));
+    if (subgroupElect()) atomicAdd(p_Frame.rayCounter.traced, traced);
+}
@@ -0,0 +1,246 @@
+#include "BindlessHeap.hpp"
+
+#include "VkCheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+void BindlessHeap::create(VkDevice device, VkPhysicalDevice physicalDevice,
+                          uint32_t bufferCapacity, uint32_t imageCapacity,
+                          uint32_t reservedImages, uint32_t framesInFlight)
+{
+    m_Device = device;
+    m_FramesInFlight = framesInFlight;
+
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    properties12.pNext = nullptr;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    auto available = [&](uint32_t limit) { return limit - std::min(limit, reservedImages); };
+
+    m_Buffers = Slots();
+    m_Buffers.capacity =
+        std::min({ bufferCapacity,
+                   properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                   properties12.maxDescriptorSetUpdateAfterBindStorageBuffers });
+    m_Images = Slots();
+    m_Images.capacity =
+        std::min({ imageCapacity,
+                   available(properties12.maxPerStageDescriptorUpdateAfterBindStorageImages),
+                   available(properties12.maxDescriptorSetUpdateAfterBindStorageImages) });
+
+    // Both arrays are visible to every stage, so together they also have to fit the per-stage
+    // resource limit. They shrink by the same factor.
+    uint64_t resources = available(properties12.maxPerStageUpdateAfterBindResources);
+    uint64_t total = static_cast<uint64_t>(m_Buffers.capacity) + m_Images.capacity;
+    if (total > resources)
+    {
+        m_Buffers.capacity = static_cast<uint32_t>(m_Buffers.capacity * resources / total);
+        m_Images.capacity = static_cast<uint32_t>(resources) - m_Buffers.capacity;
+    }
+
+    if (m_Buffers.capacity < bufferCapacity || m_Images.capacity < imageCapacity)
+    {
+        spdlog::warn("Bindless heap clamped to {} buffers and {} images by device limits",
+                     m_Buffers.capacity, m_Images.capacity);
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { {
+        { .binding = BUFFER_BINDING,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = m_Buffers.capacity,
+          .stageFlags = VK_SHADER_STAGE_ALL,
+          .pImmutableSamplers = nullptr },
+        { .binding = IMAGE_BINDING,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+          .descriptorCount = m_Images.capacity,
+          .stageFlags = VK_SHADER_STAGE_ALL,
+          .pImmutableSamplers = nullptr },
+    } };
+
+    // Slots change while frames using the set are in flight, and most of them are empty
+    VkDescriptorBindingFlags bindingFlag = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                           VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags = { bindingFlag, bindingFlag };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{};
+    bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCI.pNext = nullptr;
+    bindingFlagsCI.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsCI.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
+    descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCI.pNext = &bindingFlagsCI;
+    descriptorSetLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+    descriptorSetLayoutCI.pBindings = bindings.data();
+
+    VK_CHECK(vkCreateDescriptorSetLayout(m_Device, &descriptorSetLayoutCI, nullptr, &m_Layout));
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes = { {
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = m_Buffers.capacity },
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  .descriptorCount = m_Images.capacity  },
+    } };
+
+    VkDescriptorPoolCreateInfo descriptorPoolCI{};
+    descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCI.pNext = nullptr;
+    descriptorPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    descriptorPoolCI.maxSets = 1;
+    descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolCI.pPoolSizes = poolSizes.data();
+
+    VK_CHECK(vkCreateDescriptorPool(m_Device, &descriptorPoolCI, nullptr, &m_Pool));
+
+    VkDescriptorSetAllocateInfo descriptorSetAI{};
+    descriptorSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAI.pNext = nullptr;
+    descriptorSetAI.descriptorPool = m_Pool;
+    descriptorSetAI.descriptorSetCount = 1;
+    descriptorSetAI.pSetLayouts = &m_Layout;
+
+    VK_CHECK(vkAllocateDescriptorSets(m_Device, &descriptorSetAI, &m_Set));
+
+    m_Retired.clear();
+    m_Frame = 0;
+
+    spdlog::info("Created Bindless Heap: {} buffers, {} images", m_Buffers.capacity,
+                 m_Images.capacity);
+}
+
+void BindlessHeap::free()
+{
+    if (m_Pool == VK_NULL_HANDLE) return;
+
+    vkDestroyDescriptorPool(m_Device, m_Pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_Device, m_Layout, nullptr);
+    m_Pool = VK_NULL_HANDLE;
+    m_Layout = VK_NULL_HANDLE;
+    m_Set = VK_NULL_HANDLE;
+}
+
+BindlessHeap::Slot BindlessHeap::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                                  VkDeviceSize range)
+{
+    Slot slot = allocate(m_Buffers);
+    if (slot == INVALID_SLOT)
+    {
+        spdlog::error("Bindless heap out of buffer slots ({})", m_Buffers.capacity);
+        return INVALID_SLOT;
+    }
+
+    updateStorageBuffer(slot, buffer, offset, range);
+    return slot;
+}
+
+BindlessHeap::Slot BindlessHeap::addStorageImage(VkImageView imageView, VkImageLayout layout)
+{
+    Slot slot = allocate(m_Images);
+    if (slot == INVALID_SLOT)
+    {
+        spdlog::error("Bindless heap out of image slots ({})", m_Images.capacity);
+        return INVALID_SLOT;
+    }
+
+    updateStorageImage(slot, imageView, layout);
+    return slot;
+}
+
+void BindlessHeap::updateStorageBuffer(Slot slot, VkBuffer buffer, VkDeviceSize offset,
+                                       VkDeviceSize range)
+{
+    assert(slot < m_Buffers.highWater && "Buffer slot was never allocated");
+
+    VkDescriptorBufferInfo bufferInfo{ .buffer = buffer, .offset = offset, .range = range };
+
+    VkWriteDescriptorSet write{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = m_Set,
+                                .dstBinding = BUFFER_BINDING,
+                                .dstArrayElement = slot,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pImageInfo = nullptr,
+                                .pBufferInfo = &bufferInfo,
+                                .pTexelBufferView = nullptr };
+
+    vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+}
+
+void BindlessHeap::updateStorageImage(Slot slot, VkImageView imageView, VkImageLayout layout)
+{
+    assert(slot < m_Images.highWater && "Image slot was never allocated");
+
+    VkDescriptorImageInfo imageInfo{ .sampler = 0, .imageView = imageView, .imageLayout = layout };
+
+    VkWriteDescriptorSet write{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = m_Set,
+                                .dstBinding = IMAGE_BINDING,
+                                .dstArrayElement = slot,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                .pImageInfo = &imageInfo,
+                                .pBufferInfo = nullptr,
+                                .pTexelBufferView = nullptr };
+
+    vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+}
+
+void BindlessHeap::removeStorageBuffer(Slot slot) { remove(m_Buffers, BUFFER_BINDING, slot); }
+
+void BindlessHeap::removeStorageImage(Slot slot) { remove(m_Images, IMAGE_BINDING, slot); }
+
+void BindlessHeap::nextFrame()
+{
+    m_Frame++;
+
+    std::erase_if(m_Retired, [&](const Retired& retired) {
+        if (retired.frame + m_FramesInFlight > m_Frame) return false;
+
+        Slots& slots = retired.binding == BUFFER_BINDING ? m_Buffers : m_Images;
+        slots.free.push_back(retired.slot);
+        return true;
+    });
+}
+
+BindlessHeap::Slot BindlessHeap::allocate(Slots& slots)
+{
+    Slot slot;
+    if (!slots.free.empty())
+    {
+        slot = slots.free.back();
+        slots.free.pop_back();
+    }
+    else if (slots.highWater < slots.capacity)
+    {
+        slot = slots.highWater++;
+    }
+    else
+    {
+        return INVALID_SLOT;
+    }
+
+    slots.count++;
+    return slot;
+}
+
+void BindlessHeap::remove(Slots& slots, uint32_t binding, Slot slot)
+{
+    if (slot == INVALID_SLOT) return;
+
+    assert(slot < slots.highWater && "Slot was never allocated");
+
+    // Frames already recorded may still read the old descriptor, so the slot is not handed out
+    // again until they have finished
+    slots.count--;
+    m_Retired.push_back({ .slot = slot, .binding = binding, .frame = m_Frame });
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// One descriptor set holding large arrays of storage buffers and storage images (3D voxel
+// volumes included), so shaders address resources by slot index. The arrays are partially bound
+// and update-after-bind: slots can be written while the set is bound to frames in flight, and
+// unwritten slots are never read.
+//
+// layout (set = N, binding = BUFFER_BINDING) buffer ... b_Buffers[];
+// layout (set = N, binding = IMAGE_BINDING, r8ui) uniform uimage3D b_Volumes[];
+class BindlessHeap
+{
+  public:
+    using Slot = uint32_t;
+    static const Slot INVALID_SLOT = UINT32_MAX;
+
+    static const uint32_t BUFFER_BINDING = 0;
+    static const uint32_t IMAGE_BINDING = 1;
+
+  public:
+    BindlessHeap() {}
+    BindlessHeap(BindlessHeap&) = delete;
+    BindlessHeap(BindlessHeap&&) = delete;
+
+    // Capacities are clamped to the device's update-after-bind limits, which count every set of
+    // a pipeline layout. reservedImages is the storage images the other sets of the layouts
+    // using the heap bind. Freed slots are reused once framesInFlight calls to nextFrame() have
+    // passed.
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t bufferCapacity,
+                uint32_t imageCapacity, uint32_t reservedImages, uint32_t framesInFlight);
+    void free();
+
+    // Returns INVALID_SLOT when the heap is full
+    Slot addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                          VkDeviceSize range = VK_WHOLE_SIZE);
+    Slot addStorageImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
+
+    // Points an allocated slot at another resource
+    void updateStorageBuffer(Slot slot, VkBuffer buffer, VkDeviceSize offset = 0,
+                             VkDeviceSize range = VK_WHOLE_SIZE);
+    void updateStorageImage(Slot slot, VkImageView imageView,
+                            VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
+
+    // The slot stays valid for frames already recorded and is handed out again later
+    void removeStorageBuffer(Slot slot);
+    void removeStorageImage(Slot slot);
+
+    // Call once per frame, after waiting on the fence of the frame being reused
+    void nextFrame();
+
+    VkDescriptorSetLayout getLayout() const { return m_Layout; }
+    VkDescriptorSet getSet() const { return m_Set; }
+
+    uint32_t getBufferCapacity() const { return m_Buffers.capacity; }
+    uint32_t getImageCapacity() const { return m_Images.capacity; }
+    uint32_t getBufferCount() const { return m_Buffers.count; }
+    uint32_t getImageCount() const { return m_Images.count; }
+
+  private:
+    struct Slots {
+        uint32_t capacity = 0;
+        uint32_t count = 0;
+        // Slots below this have been handed out at least once
+        uint32_t highWater = 0;
+        std::vector<Slot> free;
+    };
+
+    struct Retired {
+        Slot slot;
+        uint32_t binding;
+        uint64_t frame;
+    };
+
+    VkDevice m_Device;
+    VkDescriptorPool m_Pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_Layout = VK_NULL_HANDLE;
+    VkDescriptorSet m_Set = VK_NULL_HANDLE;
+
+    Slots m_Buffers;
+    Slots m_Images;
+
+    std::vector<Retired> m_Retired;
+    uint64_t m_Frame = 0;
+    uint32_t m_FramesInFlight = 0;
+
+  private:
+    static Slot allocate(Slots& slots);
+    void remove(Slots& slots, uint32_t binding, Slot slot);
+};
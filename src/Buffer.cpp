@@ -4,22 +4,33 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+
+std::vector<uint32_t> Buffer::s_QueueFamilies;
+
 Buffer::Buffer() {}
 
 Buffer::~Buffer() { free(); }
 
 void Buffer::create(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage,
-                    VmaMemoryUsage memoryUsage)
+                    VmaMemoryUsage memoryUsage, MemoryCategory category)
 {
     assert(m_Buffer == 0 && "Buffer already initialized");
 
     m_Allocator = allocator;
+    m_Category = category;
 
     VkBufferCreateInfo bufferCI{};
     bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCI.pNext = nullptr;
     bufferCI.size = size;
     bufferCI.usage = usage;
+    if (s_QueueFamilies.size() > 1)
+    {
+        bufferCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferCI.queueFamilyIndexCount = static_cast<uint32_t>(s_QueueFamilies.size());
+        bufferCI.pQueueFamilyIndices = s_QueueFamilies.data();
+    }
 
     VmaAllocationCreateInfo vmaACI{};
     vmaACI.usage = memoryUsage;
@@ -28,6 +39,7 @@ void Buffer::create(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlag
     // VK_CHECK(vkCreateBuffer(m_Device, &bufferCI, nullptr, &m_Buffer));
     VK_CHECK(vmaCreateBuffer(m_Allocator, &bufferCI, &vmaACI, &m_Buffer, &m_Allocation,
                              &m_AllocationInfo));
+    MemoryBudget::track(m_Category, m_AllocationInfo.size);
     spdlog::info("Created buffer with size: {}", size);
 }
 
@@ -37,6 +49,7 @@ void Buffer::free()
 
     spdlog::info("Freeing Buffer");
     vmaDestroyBuffer(m_Allocator, m_Buffer, m_Allocation);
+    MemoryBudget::untrack(m_Category, m_AllocationInfo.size);
 
     m_Allocator = 0;
     m_Buffer = 0;
@@ -44,6 +57,19 @@ void Buffer::free()
     m_AllocationInfo = {};
 }
 
+void Buffer::setQueueFamilies(const std::vector<uint32_t>& queueFamilies)
+{
+    s_QueueFamilies.clear();
+    for (uint32_t queueFamily : queueFamilies)
+    {
+        if (std::find(s_QueueFamilies.begin(), s_QueueFamilies.end(), queueFamily) ==
+            s_QueueFamilies.end())
+        {
+            s_QueueFamilies.push_back(queueFamily);
+        }
+    }
+}
+
 VkDeviceAddress Buffer::getDeviceAddress(VkDevice device) const
 {
     VkBufferDeviceAddressInfo deviceAI{};
@@ -56,14 +82,17 @@ VkDeviceAddress Buffer::getDeviceAddress(VkDevice device) const
     return address;
 }
 
-void Buffer::copyFromBuffer(const Buffer& buffer, size_t size, size_t srcOffset, size_t dstOffset)
+ImmediateSubmit::Handle Buffer::copyFromBuffer(const Buffer& buffer, size_t size, size_t srcOffset,
+                                               size_t dstOffset)
 {
-    ImmediateSubmit::submit([&](VkCommandBuffer cmd) {
-        VkBufferCopy copy{};
-        copy.srcOffset = srcOffset;
-        copy.dstOffset = dstOffset;
-        copy.size = size;
-
-        vkCmdCopyBuffer(cmd, buffer.getBuffer(), getBuffer(), 1, &copy);
-    });
+    return ImmediateSubmit::enqueue(
+        [&](VkCommandBuffer cmd) {
+            VkBufferCopy copy{};
+            copy.srcOffset = srcOffset;
+            copy.dstOffset = dstOffset;
+            copy.size = size;
+
+            vkCmdCopyBuffer(cmd, buffer.getBuffer(), getBuffer(), 1, &copy);
+        },
+        size);
 }
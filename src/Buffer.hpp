@@ -5,8 +5,11 @@
 
 #include <memory>
 #include <span>
+#include <vector>
 
 #include "ImmediateSubmit.hpp"
+#include "MemoryBudget.hpp"
+#include "StagingRing.hpp"
 
 class Buffer
 {
@@ -16,6 +19,9 @@ class Buffer
     VmaAllocationInfo m_AllocationInfo;
 
     VmaAllocator m_Allocator;
+    MemoryCategory m_Category;
+
+    static std::vector<uint32_t> s_QueueFamilies;
 
   public:
     Buffer();
@@ -25,35 +31,25 @@ class Buffer
     ~Buffer();
 
     void create(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage,
-                VmaMemoryUsage properties);
+                VmaMemoryUsage properties, MemoryCategory category = MemoryCategory::Other);
     void free();
 
+    // Buffers are shared concurrently when uploads and rendering use different queue families
+    static void setQueueFamilies(const std::vector<uint32_t>& queueFamilies);
+
     VkBuffer getBuffer() const { return m_Buffer; }
     VmaAllocation getAllocation() const { return m_Allocation; }
     VmaAllocationInfo getAllocationInfo() const { return m_AllocationInfo; }
 
     VkDeviceAddress getDeviceAddress(VkDevice device) const;
 
-    void copyFromBuffer(const Buffer& buffer, size_t size, size_t srcOffset = 0,
-                        size_t dstOffset = 0);
+    // Batched, wait on the handle before reading the result on the CPU
+    ImmediateSubmit::Handle copyFromBuffer(const Buffer& buffer, size_t size, size_t srcOffset = 0,
+                                           size_t dstOffset = 0);
 
     template<typename T>
-    void copyFromData(const std::span<T>& data)
+    void copyFromData(const std::span<T>& data, size_t dstOffset = 0)
     {
-        size_t size = data.size() * sizeof(T);
-        Buffer stagingBuffer;
-        stagingBuffer.create(m_Allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-        memcpy(stagingBuffer.getAllocationInfo().pMappedData, data.data(), size);
-
-        ImmediateSubmit::submit([&](VkCommandBuffer cmd) {
-            VkBufferCopy copy{};
-            copy.srcOffset = 0;
-            copy.dstOffset = 0;
-            copy.size = size;
-
-            vkCmdCopyBuffer(cmd, stagingBuffer.getBuffer(), getBuffer(), 1, &copy);
-        });
+        StagingRing::upload(m_Buffer, dstOffset, data.data(), data.size() * sizeof(T));
     }
 };
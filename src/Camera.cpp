@@ -29,56 +29,37 @@ void Camera::setWorldAxis(glm::vec3 worldUp, glm::vec3 worldForward, glm::vec3 w
     updateAxis();
 }
 
-void Camera::receive(const Event* event)
+void Camera::receive(const KeyboardInput& input)
 {
-    static std::map<uint32_t, bool> m_PressedKeys;
-
-    switch (event->getType())
-    {
-    case EventType::KeyboardInput:
-        {
-            const KeyboardInput* ki = reinterpret_cast<const KeyboardInput*>(event);
-
-            m_PressedKeys[ki->key] = (ki->action != GLFW_RELEASE);
-
-            break;
-        }
-    case EventType::MouseMove:
-        {
-            const MouseMove* mi = reinterpret_cast<const MouseMove*>(event);
-            if (!mi->captured) break;
-
-            const float mouseSensitivity = 0.5;
-            m_Yaw -= mi->delta.x * mouseSensitivity;
-            m_Pitch += mi->delta.y * mouseSensitivity;
-            m_Pitch = std::clamp(m_Pitch, -90.0f, 90.0f);
-
-            updateAxis();
-
-            break;
-        }
-    case EventType::GameUpdate:
-        {
-            const GameUpdate* gu = reinterpret_cast<const GameUpdate*>(event);
-
-            glm::vec3 direction{ 0.f };
-            float speed = m_MovementSpeed;
-
-            if (m_PressedKeys[GLFW_KEY_W]) direction += m_Forward;
-            if (m_PressedKeys[GLFW_KEY_S]) direction -= m_Forward;
-            if (m_PressedKeys[GLFW_KEY_A]) direction -= m_Right;
-            if (m_PressedKeys[GLFW_KEY_D]) direction += m_Right;
-            if (m_PressedKeys[GLFW_KEY_SPACE]) direction += m_WorldUp;
-            if (m_PressedKeys[GLFW_KEY_LEFT_CONTROL]) direction -= m_WorldUp;
-            if (m_PressedKeys[GLFW_KEY_LEFT_SHIFT]) speed *= m_Speedup;
-
-            m_Position += direction * speed * gu->frameDelta;
-
-            break;
-        }
-    default:
-        break;
-    }
+    m_PressedKeys[input.key] = (input.action != GLFW_RELEASE);
+}
+
+void Camera::receive(const MouseMove& move)
+{
+    if (!move.captured) return;
+
+    const float mouseSensitivity = 0.5;
+    m_Yaw -= move.delta.x * mouseSensitivity;
+    m_Pitch += move.delta.y * mouseSensitivity;
+    m_Pitch = std::clamp(m_Pitch, -90.0f, 90.0f);
+
+    updateAxis();
+}
+
+void Camera::receive(const GameUpdate& update)
+{
+    glm::vec3 direction{ 0.f };
+    float speed = m_MovementSpeed;
+
+    if (m_PressedKeys[GLFW_KEY_W]) direction += m_Forward;
+    if (m_PressedKeys[GLFW_KEY_S]) direction -= m_Forward;
+    if (m_PressedKeys[GLFW_KEY_A]) direction -= m_Right;
+    if (m_PressedKeys[GLFW_KEY_D]) direction += m_Right;
+    if (m_PressedKeys[GLFW_KEY_SPACE]) direction += m_WorldUp;
+    if (m_PressedKeys[GLFW_KEY_LEFT_CONTROL]) direction -= m_WorldUp;
+    if (m_PressedKeys[GLFW_KEY_LEFT_SHIFT]) speed *= m_Speedup;
+
+    m_Position += direction * speed * update.frameDelta;
 }
 
 void Camera::updateAxis()
@@ -2,9 +2,11 @@
 
 #include <glm/glm.hpp>
 
+#include <map>
+
 #include "Events.hpp"
 
-class Camera : public EventReceiver
+class Camera
 {
   public:
     Camera();
@@ -13,12 +15,14 @@ class Camera : public EventReceiver
 
     void setWorldAxis(glm::vec3 worldUp, glm::vec3 worldForward, glm::vec3 worldRight);
 
-    void receive(const Event* event) override;
+    void receive(const KeyboardInput& input);
+    void receive(const MouseMove& move);
+    void receive(const GameUpdate& update);
 
-    glm::vec4 getPosition() { return glm::vec4(m_Position, 0.f); }
-    glm::vec4 getForward() { return glm::vec4(m_Forward, 0.f); }
-    glm::vec4 getRight() { return glm::vec4(m_Right, 0.f); }
-    glm::vec4 getUp() { return glm::vec4(m_Up, 0.f); }
+    glm::vec4 getPosition() const { return glm::vec4(m_Position, 0.f); }
+    glm::vec4 getForward() const { return glm::vec4(m_Forward, 0.f); }
+    glm::vec4 getRight() const { return glm::vec4(m_Right, 0.f); }
+    glm::vec4 getUp() const { return glm::vec4(m_Up, 0.f); }
 
   private:
     glm::vec3 m_Position;
@@ -26,6 +30,7 @@ class Camera : public EventReceiver
     float m_Pitch;
     float m_MovementSpeed = 2.0f;
     float m_Speedup = 2.0f;
+    std::map<int32_t, bool> m_PressedKeys;
 
     glm::vec3 m_Forward;
     glm::vec3 m_Right;
@@ -0,0 +1,346 @@
+#include "ChunkManager.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+
+static int32_t lengthSquared(glm::ivec3 v) { return v.x * v.x + v.y * v.y + v.z * v.z; }
+
+void chunkToBricks(std::span<const MaterialIndex> dense, std::span<MaterialIndex> bricks)
+{
+    assert(dense.size() == CHUNK_VOXELS && bricks.size() == CHUNK_VOXELS);
+
+    MaterialIndex* out = bricks.data();
+    for (uint32_t by = 0; by < CHUNK_BRICKS; by++)
+    {
+        for (uint32_t bz = 0; bz < CHUNK_BRICKS; bz++)
+        {
+            for (uint32_t bx = 0; bx < CHUNK_BRICKS; bx++)
+            {
+                for (uint32_t y = by * BRICK_SIZE; y < (by + 1) * BRICK_SIZE; y++)
+                {
+                    for (uint32_t z = bz * BRICK_SIZE; z < (bz + 1) * BRICK_SIZE; z++)
+                    {
+                        const MaterialIndex* row =
+                            &dense[bx * BRICK_SIZE + z * CHUNK_SIZE + y * CHUNK_SIZE * CHUNK_SIZE];
+                        std::copy(row, row + BRICK_SIZE, out);
+                        out += BRICK_SIZE;
+                    }
+                }
+            }
+        }
+    }
+}
+
+ChunkManager::ChunkManager() {}
+
+ChunkManager::~ChunkManager() { free(); }
+
+void ChunkManager::init(World* world, ChunkGenerator generator, uint32_t viewDistance,
+                        JobSystem* jobSystem)
+{
+    assert(world->getGridDimensions().x % CHUNK_BRICKS == 0 &&
+           world->getGridDimensions().y % CHUNK_BRICKS == 0 &&
+           world->getGridDimensions().z % CHUNK_BRICKS == 0 &&
+           "World grid must hold a whole number of chunks");
+
+    m_World = world;
+    m_Generator = std::move(generator);
+    m_ViewDistance = static_cast<int32_t>(viewDistance);
+    m_JobSystem = jobSystem;
+    m_Running = true;
+
+    spdlog::info("Created Chunk Manager: view distance {}", viewDistance);
+}
+
+void ChunkManager::free()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Running = false;
+        m_Requests.clear();
+        m_Completed.clear();
+    }
+
+    // Jobs still running see m_Running and drop their chunk
+    if (m_JobSystem != nullptr) m_JobSystem->wait(m_GenerateJobs);
+    m_JobSystem = nullptr;
+
+    m_Resident.clear();
+    m_LRU.clear();
+    m_Requested.clear();
+}
+
+void ChunkManager::update(glm::vec3 cameraPosition)
+{
+    m_Frame++;
+
+    glm::ivec3 cameraChunk =
+        glm::ivec3(glm::floor(cameraPosition / static_cast<float>(CHUNK_SIZE)));
+    glm::ivec3 windowChunks = glm::ivec3(m_World->getGridDimensions() / CHUNK_BRICKS);
+    glm::ivec3 windowOrigin = cameraChunk - windowChunks / 2;
+
+    if (windowOrigin != getWindowOrigin())
+    {
+        // Chunks leaving the window have to go before their grid cells are reused
+        std::vector<glm::ivec3> leaving;
+        for (const auto& [position, chunk] : m_Resident)
+        {
+            glm::ivec3 local = position - windowOrigin;
+            if (glm::any(glm::lessThan(local, glm::ivec3(0))) ||
+                glm::any(glm::greaterThanEqual(local, windowChunks)))
+                leaving.push_back(position);
+        }
+
+        for (const glm::ivec3& position : leaving)
+        {
+            evict(position);
+        }
+
+        m_World->setGridOrigin(windowOrigin * static_cast<int32_t>(CHUNK_BRICKS));
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::erase_if(m_Requests, [&](const glm::ivec3& position) {
+            if (inWindow(position)) return false;
+
+            m_Requested.erase(position);
+            return true;
+        });
+    }
+
+    std::vector<glm::ivec3> missing;
+    for (int32_t y = -m_ViewDistance; y <= m_ViewDistance; y++)
+    {
+        for (int32_t z = -m_ViewDistance; z <= m_ViewDistance; z++)
+        {
+            for (int32_t x = -m_ViewDistance; x <= m_ViewDistance; x++)
+            {
+                glm::ivec3 offset = { x, y, z };
+                if (lengthSquared(offset) > m_ViewDistance * m_ViewDistance) continue;
+
+                glm::ivec3 position = cameraChunk + offset;
+                if (!inWindow(position)) continue;
+
+                auto it = m_Resident.find(position);
+                if (it != m_Resident.end())
+                {
+                    it->second.lastUsed = m_Frame;
+                    m_LRU.splice(m_LRU.begin(), m_LRU, it->second.lru);
+                }
+                else if (!m_Requested.contains(position))
+                {
+                    missing.push_back(position);
+                }
+            }
+        }
+    }
+
+    if (!missing.empty())
+    {
+        std::sort(missing.begin(), missing.end(), [&](const glm::ivec3& a, const glm::ivec3& b) {
+            return lengthSquared(a - cameraChunk) < lengthSquared(b - cameraChunk);
+        });
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (const glm::ivec3& position : missing)
+        {
+            m_Requests.push_back(position);
+            m_Requested.insert(position);
+        }
+    }
+
+    scheduleGeneration();
+
+    // Bound the number of chunks uploaded per frame to keep frame times steady
+    for (uint32_t i = 0; i < MAX_RESIDENT_PER_FRAME; i++)
+    {
+        ChunkData chunk;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Completed.empty()) break;
+
+            chunk = std::move(m_Completed.front());
+            m_Completed.pop_front();
+        }
+
+        if (!m_Requested.contains(chunk.position) || m_Resident.contains(chunk.position)) continue;
+
+        if (!inWindow(chunk.position))
+        {
+            m_Requested.erase(chunk.position);
+            continue;
+        }
+
+        if (!makeResident(chunk))
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Completed.push_front(std::move(chunk));
+            break;
+        }
+
+        m_Requested.erase(chunk.position);
+    }
+}
+
+void ChunkManager::scheduleGeneration()
+{
+    size_t requests;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        requests = m_Requests.size();
+    }
+
+    // Background jobs only run on worker threads. One worker is left free for per-frame jobs
+    // when there are several, a single worker has to take chunks as well or none would load.
+    uint32_t workers = m_JobSystem->getThreadCount() - 1;
+    uint32_t running = m_GenerateJobs.getCount();
+    uint32_t limit = std::max(workers, 2u) - 1;
+    if (running >= limit) return;
+
+    // Each job takes the nearest request when it starts, so requests dropped in the meantime
+    // are simply skipped
+    size_t jobs = std::min<size_t>(requests, limit - running);
+    for (size_t i = 0; i < jobs; i++)
+    {
+        m_JobSystem->submitBackground([this]() { generateNext(); }, &m_GenerateJobs);
+    }
+}
+
+void ChunkManager::generateNext()
+{
+    glm::ivec3 position;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!m_Running || m_Requests.empty()) return;
+
+        position = m_Requests.front();
+        m_Requests.pop_front();
+    }
+
+    ChunkData chunk = generate(position);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_Running) return;
+    m_Completed.push_back(std::move(chunk));
+}
+
+ChunkData ChunkManager::generate(glm::ivec3 position)
+{
+    std::vector<MaterialIndex> dense(CHUNK_VOXELS, EMPTY_MATERIAL);
+    m_Generator(position, dense);
+
+    ChunkData chunk;
+    chunk.position = position;
+    chunk.materials.resize(CHUNK_VOXELS);
+
+    // Reorder into bricks so each can be handed to World::setBrick directly
+    chunkToBricks(dense, chunk.materials);
+
+    return chunk;
+}
+
+glm::ivec3 ChunkManager::getWindowOrigin() const
+{
+    return m_World->getGridOrigin() / static_cast<int32_t>(CHUNK_BRICKS);
+}
+
+bool ChunkManager::inWindow(glm::ivec3 position) const
+{
+    return m_World->containsBrick(position * static_cast<int32_t>(CHUNK_BRICKS));
+}
+
+void ChunkManager::receive(const MemoryPressure& pressure)
+{
+    // Only chunks that were not in view this frame go, so pressure never empties the view
+    uint32_t evicted = 0;
+    while (evicted < MAX_PRESSURE_EVICTIONS_PER_FRAME && evictLeastRecentlyUsed())
+    {
+        evicted++;
+    }
+
+    if (evicted > 0)
+    {
+        m_PressureEvictions += evicted;
+        spdlog::info("Trimmed {} resident chunks under pressure on memory heap {} ({} / {} MB)",
+                     evicted, pressure.heap, pressure.usage >> 20, pressure.budget >> 20);
+    }
+}
+
+bool ChunkManager::makeResident(const ChunkData& chunk)
+{
+    glm::ivec3 firstBrick = chunk.position * static_cast<int32_t>(CHUNK_BRICKS);
+
+    uint32_t brickIndex = 0;
+    for (uint32_t y = 0; y < CHUNK_BRICKS; y++)
+    {
+        for (uint32_t z = 0; z < CHUNK_BRICKS; z++)
+        {
+            for (uint32_t x = 0; x < CHUNK_BRICKS; x++, brickIndex++)
+            {
+                glm::ivec3 brick = firstBrick + glm::ivec3(x, y, z);
+                const MaterialIndex* materials = &chunk.materials[brickIndex * BRICK_VOXELS];
+
+                while (!m_World->setBrick(brick, materials))
+                {
+                    if (evictLeastRecentlyUsed()) continue;
+
+                    if (!m_PoolWarning)
+                    {
+                        spdlog::warn("Brick pool full with every chunk in view, deferring loads");
+                        m_PoolWarning = true;
+                    }
+
+                    // Release the bricks written so far, the chunk is retried later
+                    for (uint32_t i = 0; i < brickIndex; i++)
+                    {
+                        glm::ivec3 written = glm::ivec3(i % CHUNK_BRICKS,
+                                                        i / (CHUNK_BRICKS * CHUNK_BRICKS),
+                                                        (i / CHUNK_BRICKS) % CHUNK_BRICKS);
+                        m_World->clearBrick(firstBrick + written);
+                    }
+                    return false;
+                }
+            }
+        }
+    }
+
+    m_LRU.push_front(chunk.position);
+    m_Resident[chunk.position] = { .lastUsed = m_Frame, .lru = m_LRU.begin() };
+    m_PoolWarning = false;
+
+    return true;
+}
+
+bool ChunkManager::evictLeastRecentlyUsed()
+{
+    if (m_LRU.empty()) return false;
+
+    glm::ivec3 position = m_LRU.back();
+    if (m_Resident[position].lastUsed == m_Frame) return false;
+
+    evict(position);
+    return true;
+}
+
+void ChunkManager::evict(glm::ivec3 position)
+{
+    auto it = m_Resident.find(position);
+    if (it == m_Resident.end()) return;
+
+    glm::ivec3 firstBrick = position * static_cast<int32_t>(CHUNK_BRICKS);
+    for (uint32_t y = 0; y < CHUNK_BRICKS; y++)
+    {
+        for (uint32_t z = 0; z < CHUNK_BRICKS; z++)
+        {
+            for (uint32_t x = 0; x < CHUNK_BRICKS; x++)
+            {
+                m_World->clearBrick(firstBrick + glm::ivec3(x, y, z));
+            }
+        }
+    }
+
+    m_LRU.erase(it->second.lru);
+    m_Resident.erase(it);
+    m_Evictions++;
+}
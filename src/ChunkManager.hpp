@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Events.hpp"
+#include "JobSystem.hpp"
+#include "World.hpp"
+
+constexpr uint32_t CHUNK_BRICKS = 4;
+constexpr uint32_t CHUNK_SIZE = CHUNK_BRICKS * BRICK_SIZE;
+constexpr uint32_t CHUNK_VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Fills the materials of the chunk at the given chunk position, laid out as
+// x + z * CHUNK_SIZE + y * CHUNK_SIZE * CHUNK_SIZE. Called from worker threads.
+using ChunkGenerator =
+    std::function<void(glm::ivec3 chunkPosition, std::span<MaterialIndex> materials)>;
+
+// Reorders a generated chunk into CHUNK_BRICKS^3 bricks, x fastest then z then y, each in the
+// layout World::setBrick takes
+void chunkToBricks(std::span<const MaterialIndex> dense, std::span<MaterialIndex> bricks);
+
+struct ChunkData {
+    glm::ivec3 position;
+    // CHUNK_BRICKS^3 bricks of BRICK_VOXELS materials each, in the brick layout
+    std::vector<MaterialIndex> materials;
+};
+
+// Keeps the chunks around the camera resident in the world's brick pool. Chunks are generated
+// as jobs and the least recently used ones are evicted when the pool runs out.
+class ChunkManager
+{
+  public:
+    ChunkManager();
+    ChunkManager(ChunkManager&) = delete;
+    ChunkManager(ChunkManager&&) = delete;
+
+    ~ChunkManager();
+
+    void init(World* world, ChunkGenerator generator, uint32_t viewDistance, JobSystem* jobSystem);
+    void free();
+
+    void update(glm::vec3 cameraPosition);
+
+    // Throttles occupancy rather than freeing memory: drops chunks outside the view, least
+    // recently used first. The brick pool is allocated up front and keeps its size, so no device
+    // memory is returned here. Fewer resident bricks mean less upload traffic and a smaller
+    // octree, whose buffer shrinks on the next rebuild.
+    void receive(const MemoryPressure& pressure);
+
+    size_t getResidentCount() const { return m_Resident.size(); }
+    size_t getPendingCount() const { return m_Requested.size(); }
+    uint64_t getEvictionCount() const { return m_Evictions; }
+    uint64_t getPressureEvictionCount() const { return m_PressureEvictions; }
+
+  private:
+    struct ResidentChunk {
+        uint64_t lastUsed;
+        std::list<glm::ivec3>::iterator lru;
+    };
+
+    const uint32_t MAX_RESIDENT_PER_FRAME = 4;
+    const uint32_t MAX_PRESSURE_EVICTIONS_PER_FRAME = 16;
+
+    World* m_World = nullptr;
+    ChunkGenerator m_Generator;
+    int32_t m_ViewDistance;
+
+    uint64_t m_Frame = 0;
+    uint64_t m_Evictions = 0;
+    uint64_t m_PressureEvictions = 0;
+    bool m_PoolWarning = false;
+
+    std::unordered_map<glm::ivec3, ResidentChunk> m_Resident;
+    // Most recently used at the front
+    std::list<glm::ivec3> m_LRU;
+    // Chunks queued for generation or waiting to be made resident
+    std::unordered_set<glm::ivec3> m_Requested;
+
+    JobSystem* m_JobSystem = nullptr;
+    // One background job per chunk being generated, fewer than there are workers unless there
+    // is only one, so per-frame jobs are not stuck behind a backlog of chunks
+    JobCounter m_GenerateJobs;
+    std::mutex m_Mutex;
+    std::deque<glm::ivec3> m_Requests;
+    std::deque<ChunkData> m_Completed;
+    bool m_Running = false;
+
+  private:
+    void scheduleGeneration();
+    void generateNext();
+    ChunkData generate(glm::ivec3 position);
+
+    glm::ivec3 getWindowOrigin() const;
+    bool inWindow(glm::ivec3 position) const;
+
+    bool makeResident(const ChunkData& chunk);
+    bool evictLeastRecentlyUsed();
+    void evict(glm::ivec3 position);
+};
@@ -0,0 +1,337 @@
+#include "CpuRaytracer.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_RAYTRACER_AVX2
+#include <immintrin.h>
+#endif
+
+void CpuRaytracer::create(uint32_t width, uint32_t height, JobSystem* jobSystem)
+{
+    m_Width = width;
+    m_Height = height;
+    m_JobSystem = jobSystem;
+
+    m_Pixels.assign(static_cast<size_t>(width) * height, glm::vec4(0.0f));
+
+    spdlog::info("Created CPU raytracer: {}x{}, {}", width, height,
+                 hasPacketSupport() ? "AVX2 packets" : "scalar");
+}
+
+void CpuRaytracer::free()
+{
+    m_Pixels.clear();
+    m_Pixels.shrink_to_fit();
+    m_Width = 0;
+    m_Height = 0;
+}
+
+bool CpuRaytracer::hasPacketSupport()
+{
+#ifdef CPU_RAYTRACER_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+double CpuRaytracer::getRaysPerSecond() const
+{
+    if (m_RenderTime <= 0.0) return 0.0;
+    return static_cast<double>(m_Width) * m_Height / m_RenderTime;
+}
+
+uint64_t CpuRaytracer::render(const World& world, const Camera& camera)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Same viewport as the shaders
+    const float viewportWidth = 2.0f;
+    const float viewportHeight = 2.0f;
+    const float viewportDepth = 1.0f;
+
+    glm::vec3 position = glm::vec3(camera.getPosition());
+    glm::vec3 forward = glm::vec3(camera.getForward());
+    glm::vec3 right = glm::vec3(camera.getRight());
+    glm::vec3 up = glm::vec3(camera.getUp());
+
+    View view;
+    view.origin = position;
+    view.viewportTopLeft = position + viewportDepth * forward - (right * viewportWidth / 2.0f) +
+                           (up * viewportHeight / 2.0f);
+    view.deltaRight = right * viewportWidth;
+    view.deltaDown = -up * viewportHeight;
+    view.uvExtent = glm::vec2(glm::max(glm::ivec2(m_Width, m_Height) - 1, glm::ivec2(1)));
+    view.gridOrigin = glm::vec3(world.getOrigin());
+    view.dimensions = glm::ivec3(world.getDimensions());
+    view.world = &world;
+
+    uint32_t tilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+
+    bool packets = isUsingPackets();
+    m_JobSystem->parallelFor(tilesX * tilesY, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; tile++)
+        {
+            traceTile(view, tile, packets);
+        }
+    });
+
+    m_RenderTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return static_cast<uint64_t>(m_Width) * m_Height;
+}
+
+void CpuRaytracer::traceTile(const View& view, uint32_t tile, bool packets)
+{
+    uint32_t tilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t x0 = (tile % tilesX) * TILE_SIZE;
+    uint32_t y0 = (tile / tilesX) * TILE_SIZE;
+    uint32_t x1 = std::min(x0 + TILE_SIZE, m_Width);
+    uint32_t y1 = std::min(y0 + TILE_SIZE, m_Height);
+
+    for (uint32_t y = y0; y < y1; y++)
+    {
+        glm::vec4* row = &m_Pixels[static_cast<size_t>(y) * m_Width];
+        if (packets)
+        {
+            for (uint32_t x = x0; x < x1; x += PACKET_SIZE)
+            {
+                tracePacket(view, x, y, std::min(PACKET_SIZE, x1 - x), row + x);
+            }
+        }
+        else
+        {
+            for (uint32_t x = x0; x < x1; x++)
+            {
+                row[x] = traceRay(view, x, y);
+            }
+        }
+    }
+}
+
+bool CpuRaytracer::fetch(const View& view, glm::ivec3 cell, glm::vec4& colour)
+{
+    MaterialIndex material = view.world->getMaterial(glm::ivec3(view.gridOrigin) + cell);
+    if (material == EMPTY_MATERIAL) return false;
+
+    colour = view.world->getPalette().unpack(material).colour;
+    return true;
+}
+
+// Follows dda_voxel_raytracer.comp.glsl step for step, including its tie breaking
+glm::vec4 CpuRaytracer::traceRay(const View& view, uint32_t x, uint32_t y) const
+{
+    glm::vec2 uv = glm::vec2(x, y) / view.uvExtent;
+    glm::vec3 target = view.viewportTopLeft + uv.x * view.deltaRight + uv.y * view.deltaDown;
+    glm::vec3 direction = glm::normalize(target - view.origin);
+    glm::vec3 invDir = 1.0f / direction;
+
+    glm::vec3 gridMax = view.gridOrigin + glm::vec3(view.dimensions);
+    glm::vec3 t1 = (view.gridOrigin - view.origin) * invDir;
+    glm::vec3 t2 = (gridMax - view.origin) * invDir;
+    glm::vec3 tNear = glm::min(t1, t2);
+    glm::vec3 tFar = glm::max(t1, t2);
+
+    float gridEnter = std::max(std::max(tNear.x, tNear.y), tNear.z);
+    float gridExit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+    if (!(gridExit >= std::max(gridEnter, 0.0f))) return glm::vec4(0.0f);
+
+    float tEnter = std::max(gridEnter, 0.0f);
+    glm::vec3 entry = view.origin + direction * tEnter;
+
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(entry - view.gridOrigin)), glm::ivec3(0),
+                                 view.dimensions - 1);
+    glm::ivec3 step = glm::ivec3(glm::sign(direction));
+
+    glm::vec3 tDelta = glm::abs(invDir);
+    glm::vec3 nextBoundary =
+        view.gridOrigin + glm::vec3(cell) + glm::vec3(glm::max(step, glm::ivec3(0)));
+    glm::vec3 tMax = glm::mix(glm::vec3(1e30f), (nextBoundary - view.origin) * invDir,
+                              glm::notEqual(step, glm::ivec3(0)));
+
+    while (glm::all(glm::greaterThanEqual(cell, glm::ivec3(0))) &&
+           glm::all(glm::lessThan(cell, view.dimensions)))
+    {
+        glm::vec4 colour;
+        if (fetch(view, cell, colour)) return colour;
+
+        int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+    }
+
+    return glm::vec4(0.0f);
+}
+
+#ifdef CPU_RAYTRACER_AVX2
+
+// The same walk as traceRay() for eight rays at once. Stepping is done on all lanes together and
+// only the voxel lookups, which go through the world's brick grid, are done lane by lane.
+__attribute__((target("avx2"))) void CpuRaytracer::tracePacket(const View& view, uint32_t x,
+                                                                uint32_t y, uint32_t count,
+                                                                glm::vec4* out) const
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+    __m256 u = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), lanes)),
+                             _mm256_set1_ps(view.uvExtent.x));
+    __m256 v = _mm256_set1_ps(static_cast<float>(y) / view.uvExtent.y);
+
+    __m256 origin[3];
+    __m256 direction[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        origin[axis] = _mm256_set1_ps(view.origin[axis]);
+
+        __m256 target = _mm256_add_ps(
+            _mm256_add_ps(_mm256_set1_ps(view.viewportTopLeft[axis]),
+                          _mm256_mul_ps(u, _mm256_set1_ps(view.deltaRight[axis]))),
+            _mm256_mul_ps(v, _mm256_set1_ps(view.deltaDown[axis])));
+        direction[axis] = _mm256_sub_ps(target, origin[axis]);
+    }
+
+    __m256 lengthSquared =
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(direction[0], direction[0]),
+                                    _mm256_mul_ps(direction[1], direction[1])),
+                      _mm256_mul_ps(direction[2], direction[2]));
+    __m256 inverseLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSquared));
+
+    __m256 invDir[3];
+    __m256 gridEnter = _mm256_set1_ps(-INFINITY);
+    __m256 gridExit = _mm256_set1_ps(INFINITY);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        direction[axis] = _mm256_mul_ps(direction[axis], inverseLength);
+        invDir[axis] = _mm256_div_ps(_mm256_set1_ps(1.0f), direction[axis]);
+
+        float gridMin = view.gridOrigin[axis];
+        float gridMax = gridMin + static_cast<float>(view.dimensions[axis]);
+        __m256 t1 =
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(gridMin), origin[axis]), invDir[axis]);
+        __m256 t2 =
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(gridMax), origin[axis]), invDir[axis]);
+
+        gridEnter = _mm256_max_ps(gridEnter, _mm256_min_ps(t1, t2));
+        gridExit = _mm256_min_ps(gridExit, _mm256_max_ps(t1, t2));
+    }
+
+    __m256 tEnter = _mm256_max_ps(gridEnter, zero);
+    __m256i active = _mm256_and_si256(
+        _mm256_castps_si256(_mm256_cmp_ps(gridExit, tEnter, _CMP_GE_OQ)),
+        _mm256_cmpgt_epi32(_mm256_set1_epi32(count), lanes));
+
+    __m256i cell[3];
+    __m256i step[3];
+    __m256 tDelta[3];
+    __m256 tMax[3];
+    __m256i dimensions[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        dimensions[axis] = _mm256_set1_epi32(view.dimensions[axis]);
+
+        __m256 gridMin = _mm256_set1_ps(view.gridOrigin[axis]);
+        __m256 entry = _mm256_add_ps(origin[axis], _mm256_mul_ps(direction[axis], tEnter));
+        __m256i entryCell = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_sub_ps(entry, gridMin)));
+        cell[axis] = _mm256_min_epi32(_mm256_max_epi32(entryCell, _mm256_setzero_si256()),
+                                      _mm256_sub_epi32(dimensions[axis], _mm256_set1_epi32(1)));
+
+        __m256 positive = _mm256_cmp_ps(direction[axis], zero, _CMP_GT_OQ);
+        __m256 negative = _mm256_cmp_ps(direction[axis], zero, _CMP_LT_OQ);
+        step[axis] = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(positive), 31),
+                                      _mm256_srli_epi32(_mm256_castps_si256(negative), 31));
+
+        tDelta[axis] = _mm256_andnot_ps(signBit, invDir[axis]);
+
+        __m256 nextBoundary = _mm256_add_ps(_mm256_add_ps(gridMin, _mm256_cvtepi32_ps(cell[axis])),
+                                            _mm256_and_ps(positive, _mm256_set1_ps(1.0f)));
+        tMax[axis] = _mm256_blendv_ps(
+            _mm256_set1_ps(1e30f),
+            _mm256_mul_ps(_mm256_sub_ps(nextBoundary, origin[axis]), invDir[axis]),
+            _mm256_or_ps(positive, negative));
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        out[i] = glm::vec4(0.0f);
+    }
+
+    alignas(32) int32_t cellX[PACKET_SIZE];
+    alignas(32) int32_t cellY[PACKET_SIZE];
+    alignas(32) int32_t cellZ[PACKET_SIZE];
+
+    const __m256i minusOne = _mm256_set1_epi32(-1);
+    while (true)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            active = _mm256_and_si256(active, _mm256_cmpgt_epi32(cell[axis], minusOne));
+            active = _mm256_and_si256(active, _mm256_cmpgt_epi32(dimensions[axis], cell[axis]));
+        }
+
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(active));
+        if (mask == 0) break;
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(cellX), cell[0]);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(cellY), cell[1]);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(cellZ), cell[2]);
+
+        uint32_t hits = 0;
+        for (uint32_t remaining = mask; remaining != 0; remaining &= remaining - 1)
+        {
+            uint32_t lane = __builtin_ctz(remaining);
+            if (fetch(view, glm::ivec3(cellX[lane], cellY[lane], cellZ[lane]), out[lane]))
+                hits |= 1u << lane;
+        }
+
+        if (hits != 0)
+        {
+            __m256i hit = _mm256_cmpeq_epi32(
+                _mm256_and_si256(_mm256_set1_epi32(hits), laneBits), laneBits);
+            active = _mm256_andnot_si256(hit, active);
+            if (hits == mask) break;
+        }
+
+        __m256 xy = _mm256_cmp_ps(tMax[0], tMax[1], _CMP_LT_OQ);
+        __m256 xz = _mm256_cmp_ps(tMax[0], tMax[2], _CMP_LT_OQ);
+        __m256 yz = _mm256_cmp_ps(tMax[1], tMax[2], _CMP_LT_OQ);
+
+        __m256 activeMask = _mm256_castsi256_ps(active);
+        __m256 select[3];
+        select[0] = _mm256_and_ps(xy, xz);
+        select[1] = _mm256_andnot_ps(xy, yz);
+        select[2] = _mm256_andnot_ps(_mm256_or_ps(select[0], select[1]), activeMask);
+        select[0] = _mm256_and_ps(select[0], activeMask);
+        select[1] = _mm256_and_ps(select[1], activeMask);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            cell[axis] = _mm256_add_epi32(
+                cell[axis], _mm256_and_si256(step[axis], _mm256_castps_si256(select[axis])));
+            tMax[axis] = _mm256_add_ps(tMax[axis], _mm256_and_ps(tDelta[axis], select[axis]));
+        }
+    }
+}
+
+#else
+
+void CpuRaytracer::tracePacket(const View& view, uint32_t x, uint32_t y, uint32_t count,
+                               glm::vec4* out) const
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        out[i] = traceRay(view, x + i, y);
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Camera.hpp"
+#include "JobSystem.hpp"
+#include "World.hpp"
+
+// CPU port of the ray setup and grid DDA in the voxel raytracing shaders, used as a reference to
+// check GPU output against and as a throughput baseline. The image is split into tiles that are
+// traced in parallel. On x86 CPUs with AVX2 rows are traced as packets of eight rays, otherwise
+// and when packets are disabled every ray is traced on its own.
+class CpuRaytracer
+{
+  public:
+    // Matches the workgroup size of the shaders
+    static const uint32_t TILE_SIZE = 16;
+    static const uint32_t PACKET_SIZE = 8;
+
+  public:
+    CpuRaytracer() {}
+    CpuRaytracer(CpuRaytracer&) = delete;
+    CpuRaytracer(CpuRaytracer&&) = delete;
+
+    // Tiles are traced as jobs on the job system
+    void create(uint32_t width, uint32_t height, JobSystem* jobSystem);
+    void free();
+
+    // Traces every pixel against the window of the world, returns the number of rays traced
+    uint64_t render(const World& world, const Camera& camera);
+
+    // Packets are only used when the CPU supports AVX2
+    void setPacketsEnabled(bool enabled) { m_PacketsEnabled = enabled; }
+    bool isUsingPackets() const { return m_PacketsEnabled && hasPacketSupport(); }
+    static bool hasPacketSupport();
+
+    // Pixels are row major, with the colour of the voxel hit or zero on a miss
+    const std::vector<glm::vec4>& getPixels() const { return m_Pixels; }
+    uint32_t getWidth() const { return m_Width; }
+    uint32_t getHeight() const { return m_Height; }
+
+    // Of the last render
+    double getRenderTime() const { return m_RenderTime; }
+    double getRaysPerSecond() const;
+
+  private:
+    // Everything a ray needs, in the shaders' terms: grid positions are relative to the window
+    struct View {
+        glm::vec3 origin;
+        glm::vec3 viewportTopLeft;
+        glm::vec3 deltaRight;
+        glm::vec3 deltaDown;
+        // uv is the pixel position divided by this, the image size minus one
+        glm::vec2 uvExtent;
+
+        glm::vec3 gridOrigin;
+        glm::ivec3 dimensions;
+        const World* world;
+    };
+
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+    JobSystem* m_JobSystem = nullptr;
+    bool m_PacketsEnabled = true;
+
+    std::vector<glm::vec4> m_Pixels;
+    double m_RenderTime = 0.0;
+
+  private:
+    void traceTile(const View& view, uint32_t tile, bool packets);
+
+    glm::vec4 traceRay(const View& view, uint32_t x, uint32_t y) const;
+    // Traces count (at most PACKET_SIZE) neighbouring pixels of a row starting at x
+    void tracePacket(const View& view, uint32_t x, uint32_t y, uint32_t count,
+                     glm::vec4* out) const;
+
+    // Looks up the cell like getVoxel() in the shaders, false when it is empty
+    static bool fetch(const View& view, glm::ivec3 cell, glm::vec4& colour);
+};
@@ -2,6 +2,122 @@
 
 #include "VkCheck.hpp"
 
+#include <algorithm>
+
+void DescriptorAllocator::create(VkDevice device, uint32_t initialSets,
+                                 std::span<const PoolRatio> ratios)
+{
+    m_Device = device;
+    m_Ratios.assign(ratios.begin(), ratios.end());
+    m_SetCount = 0;
+    m_SetCapacity = 0;
+
+    m_ReadyPages.push_back(createPage(initialSets));
+    m_SetsPerPage = initialSets;
+}
+
+void DescriptorAllocator::free()
+{
+    reset();
+    for (VkDescriptorPool page : m_ReadyPages)
+    {
+        vkDestroyDescriptorPool(m_Device, page, nullptr);
+    }
+    m_ReadyPages.clear();
+    m_SetCapacity = 0;
+}
+
+void DescriptorAllocator::reset()
+{
+    for (VkDescriptorPool page : m_ReadyPages)
+    {
+        vkResetDescriptorPool(m_Device, page, 0);
+    }
+    for (VkDescriptorPool page : m_FullPages)
+    {
+        vkResetDescriptorPool(m_Device, page, 0);
+        m_ReadyPages.push_back(page);
+    }
+    m_FullPages.clear();
+    m_SetCount = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    return allocate(layout, 1).at(0);
+}
+
+std::vector<VkDescriptorSet> DescriptorAllocator::allocate(VkDescriptorSetLayout layout,
+                                                           uint32_t count)
+{
+    std::vector<VkDescriptorSetLayout> layouts(count, layout);
+    std::vector<VkDescriptorSet> sets(count);
+
+    VkDescriptorSetAllocateInfo descriptorSetAI{};
+    descriptorSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAI.pNext = nullptr;
+    descriptorSetAI.descriptorPool = getPage();
+    descriptorSetAI.descriptorSetCount = count;
+    descriptorSetAI.pSetLayouts = layouts.data();
+
+    VkResult result = vkAllocateDescriptorSets(m_Device, &descriptorSetAI, sets.data());
+
+    // The page is full, retire it and try once more in a fresh one
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        m_FullPages.push_back(descriptorSetAI.descriptorPool);
+        m_ReadyPages.pop_back();
+
+        descriptorSetAI.descriptorPool = getPage();
+        result = vkAllocateDescriptorSets(m_Device, &descriptorSetAI, sets.data());
+    }
+    VK_CHECK(result);
+
+    m_SetCount += count;
+    return sets;
+}
+
+uint32_t DescriptorAllocator::getPageCount() const
+{
+    return static_cast<uint32_t>(m_FullPages.size() + m_ReadyPages.size());
+}
+
+VkDescriptorPool DescriptorAllocator::getPage()
+{
+    if (!m_ReadyPages.empty()) return m_ReadyPages.back();
+
+    m_SetsPerPage = std::min(m_SetsPerPage + m_SetsPerPage / 2, MAX_SETS_PER_PAGE);
+    m_ReadyPages.push_back(createPage(m_SetsPerPage));
+
+    spdlog::info("Grew descriptor allocator to {} pages", getPageCount());
+    return m_ReadyPages.back();
+}
+
+VkDescriptorPool DescriptorAllocator::createPage(uint32_t setCount)
+{
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const PoolRatio& ratio : m_Ratios)
+    {
+        poolSizes.push_back({ .type = ratio.type,
+                              .descriptorCount = std::max(
+                                  static_cast<uint32_t>(ratio.ratio * setCount), 1u) });
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCI{};
+    descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCI.pNext = nullptr;
+    descriptorPoolCI.flags = 0;
+    descriptorPoolCI.maxSets = setCount;
+    descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolCI.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool page;
+    VK_CHECK(vkCreateDescriptorPool(m_Device, &descriptorPoolCI, nullptr, &page));
+
+    m_SetCapacity += setCount;
+    return page;
+}
+
 DescriptorLayoutBuilder DescriptorLayoutBuilder::start(VkDevice device)
 {
     DescriptorLayoutBuilder builder{ device };
@@ -64,17 +180,17 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build()
 
 DescriptorLayoutBuilder::DescriptorLayoutBuilder(VkDevice device) { m_Device = device; }
 
-DescriptorSetBuilder DescriptorSetBuilder::start(VkDevice device, VkDescriptorPool pool,
+DescriptorSetBuilder DescriptorSetBuilder::start(VkDevice device, DescriptorAllocator& allocator,
                                                  size_t setCount, VkDescriptorSetLayout layout)
 {
-    DescriptorSetBuilder builder{ device, pool, setCount, layout };
+    DescriptorSetBuilder builder{ device, allocator, setCount, layout };
     return builder;
 }
 
-DescriptorSetBuilder DescriptorSetBuilder::start(VkDevice device, VkDescriptorPool pool,
+DescriptorSetBuilder DescriptorSetBuilder::start(VkDevice device, DescriptorAllocator& allocator,
                                                  VkDescriptorSetLayout layout)
 {
-    DescriptorSetBuilder builder{ device, pool, 1, layout };
+    DescriptorSetBuilder builder{ device, allocator, 1, layout };
     return builder;
 }
 
@@ -233,23 +349,9 @@ std::vector<VkDescriptorSet> DescriptorSetBuilder::build()
     return m_DescriptorSets;
 }
 
-DescriptorSetBuilder::DescriptorSetBuilder(VkDevice device, VkDescriptorPool pool, size_t setCount,
-                                           VkDescriptorSetLayout layout)
+DescriptorSetBuilder::DescriptorSetBuilder(VkDevice device, DescriptorAllocator& allocator,
+                                           size_t setCount, VkDescriptorSetLayout layout)
     : m_Device{ device }, m_Sets{ setCount }, m_Layout{ layout }
 {
-    allocate(pool);
-}
-
-void DescriptorSetBuilder::allocate(VkDescriptorPool pool)
-{
-    std::vector<VkDescriptorSetLayout> layouts(m_Sets, m_Layout);
-    VkDescriptorSetAllocateInfo descriptorSetAI{};
-    descriptorSetAI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAI.descriptorPool = pool;
-    descriptorSetAI.descriptorSetCount = static_cast<uint32_t>(layouts.size());
-    descriptorSetAI.pSetLayouts = layouts.data();
-
-    m_DescriptorSets.resize(m_Sets);
-
-    VK_CHECK(vkAllocateDescriptorSets(m_Device, &descriptorSetAI, m_DescriptorSets.data()));
+    m_DescriptorSets = allocator.allocate(m_Layout, static_cast<uint32_t>(m_Sets));
 }
@@ -8,6 +8,55 @@
 
 #include "Buffer.hpp"
 
+// Hands out descriptor sets from a list of pool pages. When a page runs out another one is added,
+// each bigger than the last, so nothing has to be sized up front. Sets are never freed one by
+// one: reset() recycles every page at once, which suits allocators holding transient sets.
+class DescriptorAllocator
+{
+  public:
+    // Descriptors of a type per set in a page
+    struct PoolRatio {
+        VkDescriptorType type;
+        float ratio;
+    };
+
+    static const uint32_t MAX_SETS_PER_PAGE = 4096;
+
+  public:
+    DescriptorAllocator() {}
+    DescriptorAllocator(DescriptorAllocator&) = delete;
+    DescriptorAllocator(DescriptorAllocator&&) = delete;
+
+    void create(VkDevice device, uint32_t initialSets, std::span<const PoolRatio> ratios);
+    void free();
+
+    // Every set allocated so far becomes invalid
+    void reset();
+
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    std::vector<VkDescriptorSet> allocate(VkDescriptorSetLayout layout, uint32_t count);
+
+    uint32_t getPageCount() const;
+    uint32_t getSetCount() const { return m_SetCount; }
+    // Sets the current pages could hold
+    uint32_t getSetCapacity() const { return m_SetCapacity; }
+
+  private:
+    VkDevice m_Device;
+    std::vector<PoolRatio> m_Ratios;
+
+    std::vector<VkDescriptorPool> m_FullPages;
+    std::vector<VkDescriptorPool> m_ReadyPages;
+    uint32_t m_SetsPerPage = 0;
+
+    uint32_t m_SetCount = 0;
+    uint32_t m_SetCapacity = 0;
+
+  private:
+    VkDescriptorPool getPage();
+    VkDescriptorPool createPage(uint32_t setCount);
+};
+
 class DescriptorLayoutBuilder
 {
   public:
@@ -35,9 +84,9 @@ class DescriptorLayoutBuilder
 class DescriptorSetBuilder
 {
   public:
-    static DescriptorSetBuilder start(VkDevice device, VkDescriptorPool pool, size_t setCount,
-                                      VkDescriptorSetLayout layout);
-    static DescriptorSetBuilder start(VkDevice device, VkDescriptorPool pool,
+    static DescriptorSetBuilder start(VkDevice device, DescriptorAllocator& allocator,
+                                      size_t setCount, VkDescriptorSetLayout layout);
+    static DescriptorSetBuilder start(VkDevice device, DescriptorAllocator& allocator,
                                       VkDescriptorSetLayout layout);
 
     DescriptorSetBuilder& addWriteDescriptorSet(uint32_t binding, VkDescriptorType type,
@@ -63,11 +112,9 @@ class DescriptorSetBuilder
     std::vector<VkDescriptorSet> build();
 
   private:
-    DescriptorSetBuilder(VkDevice device, VkDescriptorPool pool, size_t setCount,
+    DescriptorSetBuilder(VkDevice device, DescriptorAllocator& allocator, size_t setCount,
                          VkDescriptorSetLayout layout);
 
-    void allocate(VkDescriptorPool pool);
-
   private:
     VkDevice m_Device;
 
@@ -0,0 +1,41 @@
+#include "DynamicResolution.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::create(VkExtent2D maxExtent, float budgetMilliseconds, bool enabled)
+{
+    m_MaxExtent = maxExtent;
+    m_Budget = budgetMilliseconds;
+    m_Scale = MAX_SCALE;
+    m_Enabled = enabled;
+
+    spdlog::info("Created Dynamic Resolution: {:.1f} ms budget, {}", m_Budget,
+                 m_Enabled ? "enabled" : "disabled");
+}
+
+void DynamicResolution::update(float gpuMilliseconds)
+{
+    // No timings yet, or the profiler is unsupported
+    if (!m_Enabled || gpuMilliseconds <= 0.0f) return;
+
+    float ratio = m_Budget / gpuMilliseconds;
+    if (std::abs(ratio - 1.0f) < TOLERANCE) return;
+
+    float ideal = m_Scale * std::sqrt(ratio);
+    m_Scale = std::clamp(m_Scale + (ideal - m_Scale) * SMOOTHING, MIN_SCALE, MAX_SCALE);
+}
+
+VkExtent2D DynamicResolution::getExtent() const
+{
+    return { .width = std::max(static_cast<uint32_t>(m_MaxExtent.width * m_Scale), 1u),
+             .height = std::max(static_cast<uint32_t>(m_MaxExtent.height * m_Scale), 1u) };
+}
+
+void DynamicResolution::setEnabled(bool enabled)
+{
+    m_Enabled = enabled;
+    if (!m_Enabled) m_Scale = MAX_SCALE;
+}
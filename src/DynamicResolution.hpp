@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Picks how much of the draw image to trace each frame so the GPU frame time stays near a
+// budget. Trace cost grows with the pixel count, so the linear scale moves with the square root
+// of budget / measured time, smoothed so single slow frames do not make it jump.
+class DynamicResolution
+{
+  public:
+    static constexpr float MIN_SCALE = 0.5f;
+    static constexpr float MAX_SCALE = 1.0f;
+    // Fraction of the way to the ideal scale taken each frame
+    static constexpr float SMOOTHING = 0.1f;
+    // Times within this fraction of the budget leave the scale alone
+    static constexpr float TOLERANCE = 0.05f;
+
+  public:
+    DynamicResolution() {}
+    DynamicResolution(DynamicResolution&) = delete;
+    DynamicResolution(DynamicResolution&&) = delete;
+
+    void create(VkExtent2D maxExtent, float budgetMilliseconds, bool enabled);
+
+    // Feeds the GPU time of the latest finished frame
+    void update(float gpuMilliseconds);
+
+    // Size of the region to trace, from the top left corner of the draw image
+    VkExtent2D getExtent() const;
+    float getScale() const { return m_Scale; }
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_Enabled; }
+    void setBudget(float milliseconds) { m_Budget = milliseconds; }
+    float getBudget() const { return m_Budget; }
+
+  private:
+    VkExtent2D m_MaxExtent;
+    float m_Budget = 16.0f;
+    float m_Scale = MAX_SCALE;
+    bool m_Enabled = true;
+};
@@ -5,46 +5,155 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
 
+#include "BindlessHeap.hpp"
 #include "Descriptors.hpp"
+#include "MemoryBudget.hpp"
 #include "PipelineBuilder.hpp"
+#include "PipelineCache.hpp"
 #include "ShaderModule.hpp"
+#include "StagingRing.hpp"
+#include "Terrain.hpp"
+#include "TransferQueue.hpp"
 #include "VkCheck.hpp"
 
 #include "Events.hpp"
 
 #include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+
+static const char* s_RaytraceModeNames[] = { "Brute Force", "Grid DDA", "Brickmap", "Octree" };
+static const char* s_RaytraceModeShaders[] = {
+    "res/shaders/basic_voxel_raytracer.comp.spv",
+    "res/shaders/dda_voxel_raytracer.comp.spv",
+    "res/shaders/brickmap_voxel_raytracer.comp.spv",
+    "res/shaders/octree_voxel_raytracer.comp.spv",
+};
+// Built with TARGET_ANY_FORMAT, these also write swapchain images
+static const char* s_RaytraceModeAnyFormatShaders[] = {
+    "res/shaders/basic_voxel_raytracer_any_format.comp.spv",
+    "res/shaders/dda_voxel_raytracer_any_format.comp.spv",
+    "res/shaders/brickmap_voxel_raytracer_any_format.comp.spv",
+    "res/shaders/octree_voxel_raytracer_any_format.comp.spv",
+};
+static_assert(std::size(s_RaytraceModeNames) == static_cast<size_t>(RaytraceMode::Count));
+static_assert(std::size(s_RaytraceModeShaders) == static_cast<size_t>(RaytraceMode::Count));
+static_assert(std::size(s_RaytraceModeAnyFormatShaders) ==
+              static_cast<size_t>(RaytraceMode::Count));
+static const char* s_DepthPrepassShader = "res/shaders/depth_prepass.comp.spv";
+static const char* s_OccluderSplatShader = "res/shaders/occluder_splat.comp.spv";
+
+// GLFW is not initialised in headless runs, so timing does not go through it
+static double getTime()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static glm::u8vec3 toByte(glm::vec3 colour)
+{
+    return glm::u8vec3(glm::clamp(colour, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static bool writePpm(const std::string& path, uint32_t width, uint32_t height,
+                     const std::function<glm::vec3(uint32_t x, uint32_t y)>& pixel)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        spdlog::error("Failed to open {}", path);
+        return false;
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<uint8_t> row(width * 3);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            glm::u8vec3 bytes = toByte(pixel(x, y));
+            row[x * 3 + 0] = bytes.r;
+            row[x * 3 + 1] = bytes.g;
+            row[x * 3 + 2] = bytes.b;
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+
+    spdlog::info("Wrote {}", path);
+    return true;
+}
 
-void Engine::init()
+void Engine::init(const EngineOptions& options)
 {
-    m_Window.create("Voxel Engine", 500, 500);
+    m_Options = options;
+
+    EventHandler::init();
+    if (!m_Options.headless) m_Window.create("Voxel Engine", m_Options.width, m_Options.height);
 
     initVulkan();
     initSwapchain();
     initCommandPool();
     ImmediateSubmit::init(m_Device, m_GraphicsQueue.queue, m_GraphicsQueue.queueFamily);
+    TransferQueue::init(m_Device, m_TransferQueue.queue, m_TransferQueue.queueFamily);
+    StagingRing::init(m_Allocator, STAGING_RING_SIZE);
     initSyncStructures();
-    initImGui();
-    initVoxelBuffer();
-    initDescriptorPool();
+    m_GpuProfiler.create(m_Device, m_PhysicalDevice, m_GraphicsQueue.queueFamily,
+                         FRAMES_IN_FLIGHT);
+    m_FrameAllocator.create(m_Allocator, m_Device, m_PhysicalDevice, FRAME_ALLOCATOR_REGION_SIZE,
+                            FRAMES_IN_FLIGHT);
+    if (!m_Options.headless) initImGui();
+    m_JobSystem.create();
+    m_BindlessHeap.create(m_Device, m_PhysicalDevice, BINDLESS_BUFFER_CAPACITY,
+                          BINDLESS_IMAGE_CAPACITY, VOXEL_LAYOUT_STORAGE_IMAGES, FRAMES_IN_FLIGHT);
+    initWorld();
+    initDescriptorAllocators();
+    m_TemporalCache.create(m_Allocator, m_Device, m_DescriptorAllocator, m_DrawImage.getExtent(),
+                           FRAMES_IN_FLIGHT);
+    m_TemporalCache.setEnabled(m_Options.reprojection && !m_Options.cpuReference);
     initDescriptorLayouts();
+    m_PipelineCache.create(m_Device, m_PhysicalDevice, PIPELINE_CACHE_PATH);
+    m_WorkgroupTuner.create(m_Device, m_PhysicalDevice, m_GraphicsQueue.queueFamily,
+                            WORKGROUP_CACHE_PATH);
     initPipelines();
     initDescriptorSets();
 
+    // Startup work recorded through ImmediateSubmit goes out as a few batches
+    ImmediateSubmit::wait(ImmediateSubmit::flush());
+
     m_Camera = Camera(glm::vec3(8.0f, 8.0f, -10.0f));
+    tuneWorkgroupSizes();
+
+    m_Telemetry.setExport(TELEMETRY_EXPORT_PATH, TELEMETRY_EXPORT_INTERVAL);
 
-    EventHandler::subscribe(
-        { EventType::KeyboardInput, EventType::MouseMove, EventType::GameUpdate }, &m_Camera);
+    EventHandler::subscribe<KeyboardInput>(&m_Camera);
+    EventHandler::subscribe<MouseMove>(&m_Camera);
+    EventHandler::subscribe<GameUpdate>(&m_Camera);
+    EventHandler::subscribe<MemoryPressure>(&m_ChunkManager);
 }
 
 void Engine::start()
 {
+    if (m_Options.headless)
+    {
+        runHeadless();
+        return;
+    }
+
     float currentTime;
-    float previousTime = glfwGetTime();
+    float previousTime = getTime();
     // return;
     while (!m_Window.shouldClose())
     {
-        currentTime = glfwGetTime();
+        currentTime = getTime();
         float frameDelta = currentTime - previousTime;
         previousTime = currentTime;
 
@@ -52,12 +161,148 @@ void Engine::start()
 
         m_Window.pollInput();
 
+        double updateStart = getTime();
         update(frameDelta);
+        m_Stats.updateTime = getTime() - updateStart;
 
         render(frameDelta);
 
         m_Window.swapBuffes();
+
+        m_Telemetry.push({ .frameTime = frameDelta,
+                           .updateTime = m_Stats.updateTime,
+                           .recordTime = m_Stats.recordTime,
+                           .submitTime = m_Stats.submitTime,
+                           .gpuTime = m_GpuProfiler.getTotalMilliseconds() / 1000.0f });
+    }
+}
+
+void Engine::runHeadless()
+{
+    // One orbit around the start position over the run, looking along the path and down
+    const glm::vec3 pathCentre = glm::vec3(8.0f, 8.0f, -10.0f);
+    const float pathRadius = 64.0f;
+    const float pathPitch = -20.0f;
+
+    if (m_Options.dumpInterval > 0)
+    {
+        VkExtent3D extent = m_DrawImage.getExtent();
+        m_ReadbackBuffer.create(m_Allocator, extent.width * extent.height * 4 * sizeof(uint16_t),
+                                VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                MemoryCategory::Readback);
+
+        if (m_Options.cpuReference)
+            m_CpuRaytracer.create(extent.width, extent.height, &m_JobSystem);
+    }
+    else if (m_Options.cpuReference)
+    {
+        spdlog::warn("The CPU reference is only traced for dumped frames, use --dump-every");
+    }
+
+    m_Telemetry.setExport(m_Options.timingsPath, 0.0f);
+    spdlog::info("Rendering {} headless frames", m_Options.frames);
+
+    double previousTime = getTime();
+    for (uint32_t frame = 0; frame < m_Options.frames; frame++)
+    {
+        double currentTime = getTime();
+        float frameDelta = currentTime - previousTime;
+        previousTime = currentTime;
+
+        m_Stats.frameDelta = frameDelta;
+
+        float angle = glm::two_pi<float>() * frame / m_Options.frames;
+        glm::vec3 position =
+            pathCentre + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * pathRadius;
+        m_Camera = Camera(position, glm::degrees(angle), pathPitch);
+
+        double updateStart = getTime();
+        update(frameDelta);
+        m_Stats.updateTime = getTime() - updateStart;
+
+        render(frameDelta);
+
+        writePendingDump(false);
+
+        m_Telemetry.push({ .frameTime = frameDelta,
+                           .updateTime = m_Stats.updateTime,
+                           .recordTime = m_Stats.recordTime,
+                           .submitTime = m_Stats.submitTime,
+                           .gpuTime = m_GpuProfiler.getTotalMilliseconds() / 1000.0f });
+
+        // Exported before frames fall out of the telemetry window
+        if ((frame + 1) % (FrameTelemetry::CAPACITY / 2) == 0) m_Telemetry.exportNow();
+    }
+
+    vkDeviceWaitIdle(m_Device);
+    writePendingDump(true);
+    m_Telemetry.exportNow();
+
+    const FrameSummary& summary = m_Telemetry.getSummary();
+    spdlog::info("Headless run: p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms, "
+                 "{} hitches",
+                 summary.p50 * 1000.0f, summary.p95 * 1000.0f, summary.p99 * 1000.0f,
+                 summary.max * 1000.0f, m_Telemetry.getHitchCount());
+
+    std::vector<WorkerStats> workers = m_JobSystem.getStats();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        spdlog::info("Worker {}: {} tasks, {} steals, {:.2f} s idle", i, workers[i].tasksRun,
+                     workers[i].steals, workers[i].idleTime);
+    }
+}
+
+void Engine::writePendingDump(bool wait)
+{
+    if (!m_DumpPending) return;
+
+    VkFence fence = m_Frames[m_DumpFrameIndex].renderFence;
+    if (wait)
+        VK_CHECK(vkWaitForFences(m_Device, 1, &fence, true, UINT64_MAX));
+    else if (vkGetFenceStatus(m_Device, fence) != VK_SUCCESS)
+        return;
+
+    m_DumpPending = false;
+
+    vmaInvalidateAllocation(m_Allocator, m_ReadbackBuffer.getAllocation(), 0, VK_WHOLE_SIZE);
+    const uint16_t* pixels =
+        static_cast<const uint16_t*>(m_ReadbackBuffer.getAllocationInfo().pMappedData);
+
+    VkExtent3D extent = m_DrawImage.getExtent();
+    auto gpuPixel = [&](uint32_t x, uint32_t y) {
+        const uint16_t* pixel = pixels + (y * extent.width + x) * 4;
+        return glm::vec3(glm::unpackHalf1x16(pixel[0]), glm::unpackHalf1x16(pixel[1]),
+                         glm::unpackHalf1x16(pixel[2]));
+    };
+
+    std::string path = m_Options.dumpPrefix + std::to_string(m_DumpFrame);
+    writePpm(path + ".ppm", extent.width, extent.height, gpuPixel);
+
+    if (!m_Options.cpuReference) return;
+
+    const std::vector<glm::vec4>& reference = m_CpuRaytracer.getPixels();
+    auto cpuPixel = [&](uint32_t x, uint32_t y) {
+        return glm::vec3(reference[y * extent.width + x]);
+    };
+
+    writePpm(path + "_cpu.ppm", extent.width, extent.height, cpuPixel);
+
+    // Off by one after rounding is left to the half float draw image
+    uint32_t mismatches = 0;
+    for (uint32_t y = 0; y < extent.height; y++)
+    {
+        for (uint32_t x = 0; x < extent.width; x++)
+        {
+            glm::ivec3 gpu = glm::ivec3(toByte(gpuPixel(x, y)));
+            glm::ivec3 cpu = glm::ivec3(toByte(cpuPixel(x, y)));
+            if (glm::any(glm::greaterThan(glm::abs(gpu - cpu), glm::ivec3(1)))) mismatches++;
+        }
     }
+
+    spdlog::info("Frame {}: {} of {} pixels differ from the CPU reference, traced at {:.2f} "
+                 "Mrays/s",
+                 m_DumpFrame, mismatches, extent.width * extent.height,
+                 m_CpuRaytracer.getRaysPerSecond() / 1e6);
 }
 
 void Engine::cleanup()
@@ -65,20 +310,45 @@ void Engine::cleanup()
     vkDeviceWaitIdle(m_Device);
 
     ImmediateSubmit::free();
-
-    m_VoxelBuffer.free();
-    vkDestroyPipeline(m_Device, m_VoxelPipeline, nullptr);
+    TransferQueue::free();
+    m_GpuProfiler.free();
+    m_FrameAllocator.free();
+    StagingRing::free();
+
+    m_ChunkManager.free();
+    m_JobSystem.wait(m_OctreeJob);
+    m_JobSystem.free();
+    m_World.free();
+    m_OctreeSource.free();
+    for (Buffer& buffer : m_OctreeBuffers)
+    {
+        buffer.free();
+    }
+    for (VkPipeline pipeline : m_VoxelPipelines)
+    {
+        vkDestroyPipeline(m_Device, pipeline, nullptr);
+    }
+    vkDestroyPipeline(m_Device, m_DepthPrepassPipeline, nullptr);
+    vkDestroyPipeline(m_Device, m_OccluderSplatPipeline, nullptr);
     vkDestroyPipelineLayout(m_Device, m_VoxelPipelineLayout, nullptr);
+    m_PipelineCache.free();
+    m_WorkgroupTuner.free();
 
     vkDestroyDescriptorSetLayout(m_Device, m_VoxelDescriptorSetLayout, nullptr);
+    m_BindlessHeap.free();
+    m_TemporalCache.free();
 
-    vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
+    m_DescriptorAllocator.free();
+    m_SwapchainDescriptorAllocator.free();
 
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (!m_Options.headless)
+    {
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
 
-    vkDestroyDescriptorPool(m_Device, m_ImguiPool, nullptr);
+        vkDestroyDescriptorPool(m_Device, m_ImguiPool, nullptr);
+    }
 
     for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++)
     {
@@ -93,12 +363,15 @@ void Engine::cleanup()
     }
 
     m_DrawImage.free();
+    m_CoarseDepthImage.free();
+    m_ReadbackBuffer.free();
+    m_CpuRaytracer.free();
 
-    destroySwapchain();
+    if (!m_Options.headless) destroySwapchain();
 
     vmaDestroyAllocator(m_Allocator);
     vkDestroyDevice(m_Device, nullptr);
-    vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+    if (!m_Options.headless) vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
     vkb::destroy_debug_utils_messenger(m_Instance, m_DebugMessenger, nullptr);
     vkDestroyInstance(m_Instance, nullptr);
 }
@@ -110,13 +383,17 @@ void Engine::initVulkan()
                        .request_validation_layers(true)
                        .use_default_debug_messenger()
                        .require_api_version(1, 3, 0)
+                       .set_headless(m_Options.headless)
                        .build();
 
     vkb::Instance vkbInst = instRet.value();
     m_Instance = vkbInst.instance;
     m_DebugMessenger = vkbInst.debug_messenger;
-    m_Surface = m_Window.createSurface(m_Instance);
-    spdlog::info("Created Window Surface");
+    if (!m_Options.headless)
+    {
+        m_Surface = m_Window.createSurface(m_Instance);
+        spdlog::info("Created Window Surface");
+    }
 
     VkPhysicalDeviceVulkan13Features features13{};
     features13.dynamicRendering = true;
@@ -125,6 +402,14 @@ void Engine::initVulkan()
     VkPhysicalDeviceVulkan12Features features12{};
     features12.bufferDeviceAddress = true;
     features12.descriptorIndexing = true;
+    features12.runtimeDescriptorArray = true;
+    features12.descriptorBindingPartiallyBound = true;
+    features12.descriptorBindingUpdateUnusedWhilePending = true;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+    features12.descriptorBindingStorageImageUpdateAfterBind = true;
+    features12.shaderStorageBufferArrayNonUniformIndexing = true;
+    features12.shaderStorageImageArrayNonUniformIndexing = true;
+    features12.timelineSemaphore = true;
 
     VkPhysicalDeviceVulkan11Features features11{};
     features11.shaderDrawParameters = true;
@@ -136,13 +421,14 @@ void Engine::initVulkan()
     features.geometryShader = true;
 
     vkb::PhysicalDeviceSelector selector{ vkbInst };
-    auto vkbMaybeDevice = selector.set_minimum_version(1, 3)
-                              .set_required_features_13(features13)
-                              .set_required_features_12(features12)
-                              .set_required_features_11(features11)
-                              .set_required_features(features)
-                              .set_surface(m_Surface)
-                              .select();
+    selector.set_minimum_version(1, 3)
+        .set_required_features_13(features13)
+        .set_required_features_12(features12)
+        .set_required_features_11(features11)
+        .set_required_features(features);
+    if (!m_Options.headless) selector.set_surface(m_Surface);
+
+    auto vkbMaybeDevice = selector.select();
 
     if (!vkbMaybeDevice.has_value())
     {
@@ -151,6 +437,13 @@ void Engine::initVulkan()
     }
 
     vkb::PhysicalDevice vkbPhysicalDevice = vkbMaybeDevice.value();
+    bool memoryBudget =
+        vkbPhysicalDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Lets the raytracers write swapchain images, whose format differs from the draw image
+    VkPhysicalDeviceFeatures writeWithoutFormat{};
+    writeWithoutFormat.shaderStorageImageWriteWithoutFormat = true;
+    m_StorageWriteWithoutFormat = vkbPhysicalDevice.enable_features_if_present(writeWithoutFormat);
 
     vkb::DeviceBuilder deviceBuilder{ vkbPhysicalDevice };
     vkb::Device vkbDevice = deviceBuilder.build().value();
@@ -161,6 +454,20 @@ void Engine::initVulkan()
 
     m_GraphicsQueue.queue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     m_GraphicsQueue.queueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+
+    auto dedicatedTransfer = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+    if (dedicatedTransfer.has_value())
+    {
+        m_TransferQueue.queue = dedicatedTransfer.value();
+        m_TransferQueue.queueFamily =
+            vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+    }
+    else
+    {
+        spdlog::warn("No dedicated transfer queue, uploading on the graphics queue");
+        m_TransferQueue = m_GraphicsQueue;
+    }
+    Buffer::setQueueFamilies({ m_GraphicsQueue.queueFamily, m_TransferQueue.queueFamily });
     spdlog::info("Created Queues");
 
     VmaAllocatorCreateInfo allocatorCI{};
@@ -168,7 +475,9 @@ void Engine::initVulkan()
     allocatorCI.device = m_Device;
     allocatorCI.instance = m_Instance;
     allocatorCI.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (memoryBudget) allocatorCI.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     vmaCreateAllocator(&allocatorCI, &m_Allocator);
+    MemoryBudget::init(m_Allocator, memoryBudget);
     spdlog::info("Created Allocator");
 }
 
@@ -177,16 +486,49 @@ void Engine::createSwapchain()
     vkb::SwapchainBuilder swapchainBuilder{ m_PhysicalDevice, m_Device, m_Surface };
     m_SwapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
 
+    // vk-bootstrap falls back to another format when the surface lacks this one, and storage
+    // usage is only valid for the format checked here
+    uint32_t surfaceFormatCount = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(m_PhysicalDevice, m_Surface, &surfaceFormatCount,
+                                         nullptr);
+    std::vector<VkSurfaceFormatKHR> surfaceFormats(surfaceFormatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(m_PhysicalDevice, m_Surface, &surfaceFormatCount,
+                                         surfaceFormats.data());
+    bool formatOffered =
+        std::any_of(surfaceFormats.begin(), surfaceFormats.end(), [&](VkSurfaceFormatKHR format) {
+            return format.format == m_SwapchainImageFormat &&
+                   format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        });
+
+    // Storage writes need both the surface and the format to allow them. The format is UNORM,
+    // so the raytracers write the same values the blit would copy.
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_PhysicalDevice, m_Surface, &surfaceCapabilities);
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, m_SwapchainImageFormat,
+                                        &formatProperties);
+
+    m_SwapchainStorage =
+        m_Options.traceToSwapchain && m_StorageWriteWithoutFormat && formatOffered &&
+        (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) != 0 &&
+        (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+    if (m_Options.traceToSwapchain && !m_SwapchainStorage)
+        spdlog::warn("Swapchain images do not support storage, raytracing through a blit");
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (m_SwapchainStorage) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+
     vkb::Swapchain vkbSwapchain =
         swapchainBuilder
             .set_desired_format({ .format = m_SwapchainImageFormat,
                                   .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
             .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
             .set_desired_extent(m_Window.getSize().x, m_Window.getSize().y)
-            .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+            .add_image_usage_flags(usage)
             .build()
             .value();
 
+    m_SwapchainImageFormat = vkbSwapchain.image_format;
     m_SwapchainImageExtent = vkbSwapchain.extent;
     m_Swapchain = vkbSwapchain.swapchain;
     m_SwapchainImages = vkbSwapchain.get_images().value();
@@ -196,18 +538,32 @@ void Engine::createSwapchain()
 
 void Engine::initSwapchain()
 {
-    createSwapchain();
+    if (!m_Options.headless) createSwapchain();
 
-    VkExtent3D drawImageExtent = { m_Window.getSize().x, m_Window.getSize().y, 1 };
+    VkExtent3D drawImageExtent = { m_Options.width, m_Options.height, 1 };
 
     m_DrawImage.create(m_Allocator, VK_FORMAT_R16G16B16A16_SFLOAT, drawImageExtent,
                        VK_IMAGE_TYPE_2D,
                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                       VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                       VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                       MemoryCategory::RenderTarget);
 
     m_DrawImage.createImageView(m_Device, VK_IMAGE_VIEW_TYPE_2D);
 
+    VkExtent3D coarseDepthExtent = {
+        (drawImageExtent.width + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE,
+        (drawImageExtent.height + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE, 1 };
+    m_CoarseDepthImage.create(m_Allocator, VK_FORMAT_R32_SFLOAT, coarseDepthExtent,
+                              VK_IMAGE_TYPE_2D, VK_IMAGE_USAGE_STORAGE_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              MemoryCategory::RenderTarget);
+    m_CoarseDepthImage.createImageView(m_Device, VK_IMAGE_VIEW_TYPE_2D);
+
+    m_DynamicResolution.create({ drawImageExtent.width, drawImageExtent.height },
+                               m_Options.gpuBudget,
+                               !m_Options.headless && m_Options.gpuBudget > 0.0f);
+
     spdlog::info("Createed Swapchain ImageView");
 }
 
@@ -236,7 +592,8 @@ void Engine::initCommandPool()
     commandBufferAI.commandBufferCount = 1;
     commandBufferAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    m_Frames.resize(FRAMES_IN_FLIGHT);
+    // Built in place, FrameData cannot be moved
+    m_Frames = std::vector<FrameData>(FRAMES_IN_FLIGHT);
     for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++)
     {
         VK_CHECK(vkCreateCommandPool(m_Device, &commandPoolCI, nullptr, &m_Frames[i].commandPool));
@@ -272,23 +629,16 @@ void Engine::initSyncStructures()
 
 void Engine::initImGui()
 {
+    // The backend only allocates combined image samplers, one for the font and one per texture
+    // it is given
     VkDescriptorPoolSize poolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_SAMPLER,                1000 },
-        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1000 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1000 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   1000 },
-        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       1000 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, IMGUI_DESCRIPTOR_SETS },
     };
 
     VkDescriptorPoolCreateInfo poolCI{};
     poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolCI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    poolCI.maxSets = 1000;
+    poolCI.maxSets = IMGUI_DESCRIPTOR_SETS;
     poolCI.poolSizeCount = (uint32_t)std::size(poolSizes);
     poolCI.pPoolSizes = poolSizes;
 
@@ -327,88 +677,96 @@ void Engine::initImGui()
     spdlog::info("Initializsed ImGui");
 }
 
-void Engine::initVoxelBuffer()
+void Engine::initWorld()
 {
-    std::vector<Voxel> voxels(VOXEL_SIZE * VOXEL_SIZE * VOXEL_SIZE);
-    for (uint32_t y = 0; y < VOXEL_SIZE; y++)
-    {
-        for (uint32_t z = 0; z < VOXEL_SIZE; z++)
-        {
-            for (uint32_t x = 0; x < VOXEL_SIZE; x++)
-            {
+    m_World.create(m_Allocator, WORLD_GRID_SIZE, BRICK_CAPACITY);
 
-                uint32_t layerSum = x + z;
-                uint32_t sum = x + y + z;
-                uint32_t layerIndex = z * VOXEL_SIZE + x;
-                uint32_t index = layerIndex + y * VOXEL_SIZE * VOXEL_SIZE;
+    ChunkGenerator terrain = createTerrainGenerator(m_World.getPalette());
 
-                glm::vec4 colour = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    m_ChunkManager.init(&m_World, terrain, VIEW_DISTANCE, &m_JobSystem);
 
-                if (layerSum % 2 == 0)
-                {
-                    if (sum % 2 == 0)
-                    {
-                        colour = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-                    }
-                    else
-                    {
-                        colour = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
-                    }
-                }
-                else
-                {
-                    if (sum % 2 == 0)
-                    {
-                        colour = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
-                    }
-                    else
-                    {
-                        colour = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
-                    }
-                }
+    m_World.upload(&m_JobSystem);
 
-                voxels.at(index) = { .colour = colour };
-            }
-        }
-    }
-    Buffer staging;
-    staging.create(m_Allocator, voxels.size() * sizeof(Voxel),
-                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                   VMA_MEMORY_USAGE_CPU_COPY);
+    // Nothing is in flight yet, so the first tree is built in place
+    m_OctreeSource.create(VK_NULL_HANDLE, WORLD_GRID_SIZE, BRICK_CAPACITY);
+    m_PendingOctree.build(m_World, &m_JobSystem);
+    m_OctreeBuildTime = getTime();
+    swapOctree(m_World.getVersion());
+}
+
+void Engine::updateOctree()
+{
+    // Every frame slot has been waited on since the swap, so no frame reads the old tree
+    bool spareIdle = m_FrameNumber >= m_OctreeSwapFrame + FRAMES_IN_FLIGHT;
+    if (spareIdle) m_OctreeBuffers[1 - m_OctreeCurrent].free();
 
-    staging.copyFromData<Voxel>(voxels);
+    if (m_OctreeBuilding)
+    {
+        if (!m_OctreeJob.isDone() || !spareIdle) return;
 
-    m_VoxelBuffer.create(m_Allocator, voxels.size() * sizeof(Voxel),
-                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                             VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                         VMA_MEMORY_USAGE_GPU_ONLY);
+        m_OctreeBuilding = false;
+        swapOctree(m_OctreeSource.getVersion());
+        if (m_RaytraceMode == RaytraceMode::Octree) m_SceneChanges.add(m_OctreeBuildChanges);
+        return;
+    }
 
-    m_VoxelBuffer.copyFromBuffer(staging, voxels.size() * sizeof(Voxel));
-    m_TotalVoxels = voxels.size();
-    spdlog::info("Created Vertex Buffer");
+    // Rebuilding is a full pass over the window, so streaming only starts one a second
+    if (m_RaytraceMode != RaytraceMode::Octree || m_OctreeVersion == m_World.getVersion() ||
+        getTime() - m_OctreeBuildTime < 1.0)
+        return;
+
+    m_OctreeSource.copyVoxels(m_World);
+    m_OctreeBuildChanges = m_OctreeChanges;
+    m_OctreeChanges = {};
+    m_OctreeBuildTime = getTime();
+    m_OctreeBuilding = true;
+    m_JobSystem.submitBackground(
+        [this]() { m_PendingOctree.build(m_OctreeSource, &m_JobSystem); }, &m_OctreeJob);
 }
 
-void Engine::initDescriptorPool()
+void Engine::swapOctree(uint64_t version)
 {
-    std::vector<VkDescriptorPoolSize> poolSizes = {
-        { .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  .descriptorCount = 1                },
-        { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = FRAMES_IN_FLIGHT }
-    };
-
-    VkDescriptorPoolCreateInfo descriptorPoolCI{};
-    descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptorPoolCI.pNext = nullptr;
-    descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    descriptorPoolCI.pPoolSizes = poolSizes.data();
-    descriptorPoolCI.maxSets = FRAMES_IN_FLIGHT + 1;
+    std::swap(m_Octree, m_PendingOctree);
+    m_OctreeVersion = version;
+
+    uint32_t spare = 1 - m_OctreeCurrent;
+    const std::vector<OctreeNode>& nodes = m_Octree.getNodes();
+    m_OctreeBuffers[spare].create(m_Allocator, nodes.size() * sizeof(OctreeNode),
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Octree);
+
+    // Goes out with this frame's staging flush, which the raytrace waits on
+    m_OctreeBuffers[spare].copyFromData<const OctreeNode>(nodes);
+
+    // The old slot stays valid for the frames already recorded with it
+    if (m_OctreeSlot != BindlessHeap::INVALID_SLOT)
+        m_BindlessHeap.removeStorageBuffer(m_OctreeSlot);
+    m_OctreeSlot = m_BindlessHeap.addStorageBuffer(m_OctreeBuffers[spare].getBuffer());
+
+    m_OctreeCurrent = spare;
+    m_OctreeSwapFrame = m_FrameNumber;
+    spdlog::info("Created Octree Buffer");
+}
 
-    VK_CHECK(vkCreateDescriptorPool(m_Device, &descriptorPoolCI, nullptr, &m_DescriptorPool));
-    spdlog::info("Created descriptor pool");
+void Engine::initDescriptorAllocators()
+{
+    // Descriptors per set, roughly what the engine's layouts use
+    std::array<DescriptorAllocator::PoolRatio, 2> ratios = { {
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  .ratio = 1.0f },
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .ratio = 2.0f },
+    } };
+
+    m_DescriptorAllocator.create(m_Device, DESCRIPTOR_PAGE_SETS, ratios);
+    m_SwapchainDescriptorAllocator.create(m_Device, DESCRIPTOR_PAGE_SETS, ratios);
+    spdlog::info("Created descriptor allocators");
 }
+
 void Engine::initDescriptorLayouts()
 {
     m_VoxelDescriptorSetLayout = DescriptorLayoutBuilder::start(m_Device)
                                      .addStorageImage(0, VK_SHADER_STAGE_COMPUTE_BIT)
+                                     .addStorageImage(1, VK_SHADER_STAGE_COMPUTE_BIT)
                                      .build();
     spdlog::info("Created descriptor layouts");
 }
@@ -421,100 +779,390 @@ void Engine::initPipelines()
         pushConstant.size = sizeof(VoxelPushConstants);
         pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+        // Set 1 is the bindless heap, set 2 the temporal cache's history
+        std::array<VkDescriptorSetLayout, 3> setLayouts = { m_VoxelDescriptorSetLayout,
+                                                            m_BindlessHeap.getLayout(),
+                                                            m_TemporalCache.getLayout() };
+
         VkPipelineLayoutCreateInfo computeLayoutCI{};
         computeLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         computeLayoutCI.pNext = nullptr;
-        computeLayoutCI.setLayoutCount = 1;
-        computeLayoutCI.pSetLayouts = &m_VoxelDescriptorSetLayout;
+        computeLayoutCI.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        computeLayoutCI.pSetLayouts = setLayouts.data();
         computeLayoutCI.pushConstantRangeCount = 1;
         computeLayoutCI.pPushConstantRanges = &pushConstant;
 
         VK_CHECK(
             vkCreatePipelineLayout(m_Device, &computeLayoutCI, nullptr, &m_VoxelPipelineLayout));
 
-        ShaderModule voxelShader;
-        voxelShader.create("res/shaders/basic_voxel_raytracer.comp.spv", m_Device);
+        for (size_t i = 0; i < m_VoxelPipelines.size(); i++)
+        {
+            m_WorkgroupSizes[i] = WorkgroupSize();
+            m_WorkgroupTuner.getCached(s_RaytraceModeShaders[i], m_WorkgroupSizes[i]);
+        }
+
+        // Shader loading and pipeline compilation run as one job per pipeline, all sharing the
+        // pipeline cache
+        double start = getTime();
+        m_JobSystem.parallelFor(
+            static_cast<uint32_t>(m_VoxelPipelines.size()), 1, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    ShaderModule voxelShader;
+                    voxelShader.create(getRaytraceShader(i), m_Device);
 
-        VkPipelineShaderStageCreateInfo shaderStageCI{};
-        shaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStageCI.pNext = nullptr;
-        shaderStageCI.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-        shaderStageCI.module = voxelShader.getShaderModule();
-        shaderStageCI.pName = "main";
+                    m_VoxelPipelines[i] =
+                        createVoxelPipeline(voxelShader.getShaderModule(), m_WorkgroupSizes[i]);
+                    spdlog::info("Created {} Pipeline ({}x{})", s_RaytraceModeNames[i],
+                                 m_WorkgroupSizes[i].x, m_WorkgroupSizes[i].y);
+                }
+            });
+        spdlog::info("Compiled {} pipelines in {:.1f} ms ({} cache)", m_VoxelPipelines.size(),
+                     (getTime() - start) * 1000.0, m_PipelineCache.isWarm() ? "warm" : "cold");
+        spdlog::info("Created Voxel Pipelines and Pipeline Layout");
+    }
+    {
+        // One invocation per tile, the prepass is too cheap to be worth tuning
+        ShaderModule prepassShader;
+        prepassShader.create(s_DepthPrepassShader, m_Device);
 
-        VkComputePipelineCreateInfo computePipelineCI{};
-        computePipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-        computePipelineCI.pNext = nullptr;
-        computePipelineCI.layout = m_VoxelPipelineLayout;
-        computePipelineCI.stage = shaderStageCI;
+        m_DepthPrepassPipeline =
+            createVoxelPipeline(prepassShader.getShaderModule(), DEPTH_PREPASS_WORKGROUP);
+        spdlog::info("Created Depth Prepass Pipeline");
+    }
+    {
+        ShaderModule splatShader;
+        splatShader.create(s_OccluderSplatShader, m_Device);
 
-        VK_CHECK(vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr,
-                                          &m_VoxelPipeline));
-        spdlog::info("Created Background Pipeline and Pipeline Layout");
+        m_OccluderSplatPipeline =
+            createVoxelPipeline(splatShader.getShaderModule(), OCCLUDER_SPLAT_WORKGROUP);
+        spdlog::info("Created Occluder Splat Pipeline");
     }
 }
 
 void Engine::initDescriptorSets()
 {
     m_VoxelDescriptorSet =
-        DescriptorSetBuilder::start(m_Device, m_DescriptorPool, m_VoxelDescriptorSetLayout)
+        DescriptorSetBuilder::start(m_Device, m_DescriptorAllocator, m_VoxelDescriptorSetLayout)
             .addStorageImage(0, VK_IMAGE_LAYOUT_GENERAL, m_DrawImage.getImageView())
+            .addStorageImage(1, VK_IMAGE_LAYOUT_GENERAL, m_CoarseDepthImage.getImageView())
             .build()
             .at(0);
+    // The swapchain is created before any layout exists, so its sets are first built here
+    createSwapchainDescriptorSets();
 
     spdlog::info("Created descriptors");
 }
 
-void Engine::update(float frameDelta)
+void Engine::createSwapchainDescriptorSets()
 {
-    GameUpdate update;
-    update.frameDelta = frameDelta;
-    EventHandler::dispatchEvent(&update);
+    m_SwapchainDescriptorAllocator.reset();
+    m_SwapchainDescriptorSets.clear();
+    if (!m_SwapchainStorage) return;
 
-    ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    for (VkImageView view : m_SwapchainImageViews)
+    {
+        m_SwapchainDescriptorSets.push_back(
+            DescriptorSetBuilder::start(m_Device, m_SwapchainDescriptorAllocator,
+                                        m_VoxelDescriptorSetLayout)
+                .addStorageImage(0, VK_IMAGE_LAYOUT_GENERAL, view)
+                .addStorageImage(1, VK_IMAGE_LAYOUT_GENERAL, m_CoarseDepthImage.getImageView())
+                .build()
+                .at(0));
+    }
+}
 
-    const size_t frameTimeSize = 200;
-    static float frameTimes[frameTimeSize];
-    static int currentFrame = 0;
+const char* Engine::getRaytraceShader(size_t mode) const
+{
+    // Same workgroup sizes either way, so both are tuned under the plain shader's name
+    return m_SwapchainStorage ? s_RaytraceModeAnyFormatShaders[mode] : s_RaytraceModeShaders[mode];
+}
 
-    float maxTime = 1000.0f;
-    float minTime = 0.0f;
-    float avgTime = 0.0f;
+VkPipeline Engine::createVoxelPipeline(VkShaderModule shader, WorkgroupSize size)
+{
+    // Constant ids 0 and 1 are local_size_x_id and local_size_y_id in the raytrace shaders
+    std::array<VkSpecializationMapEntry, 2> specializationEntries = { {
+        { .constantID = 0, .offset = offsetof(WorkgroupSize, x), .size = sizeof(uint32_t) },
+        { .constantID = 1, .offset = offsetof(WorkgroupSize, y), .size = sizeof(uint32_t) },
+    } };
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(size);
+    specializationInfo.pData = &size;
+
+    VkPipelineShaderStageCreateInfo shaderStageCI{};
+    shaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageCI.pNext = nullptr;
+    shaderStageCI.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageCI.module = shader;
+    shaderStageCI.pName = "main";
+    shaderStageCI.pSpecializationInfo = &specializationInfo;
+
+    VkComputePipelineCreateInfo computePipelineCI{};
+    computePipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineCI.pNext = nullptr;
+    computePipelineCI.layout = m_VoxelPipelineLayout;
+    computePipelineCI.stage = shaderStageCI;
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(m_Device, m_PipelineCache.getCache(), 1, &computePipelineCI,
+                                      nullptr, &pipeline));
+    return pipeline;
+}
 
-    frameTimes[currentFrame] = m_Stats.frameDelta;
-    if (currentFrame + 1 == frameTimeSize)
+void Engine::tuneWorkgroupSizes()
+{
+    if (!m_WorkgroupTuner.isSupported()) return;
+
+    const std::vector<WorkgroupSize>& candidates = m_WorkgroupTuner.getCandidates();
+    bool tuned = false;
+
+    // Tuning runs before the first frame, so slot 0 of the frame allocator is free. Sizes are
+    // timed on the top left corner of the draw image.
+    VkExtent2D extent = {
+        std::min(m_DrawImage.getExtent().width, WORKGROUP_TUNING_EXTENT.width),
+        std::min(m_DrawImage.getExtent().height, WORKGROUP_TUNING_EXTENT.height) };
+    m_FrameAllocator.beginFrame(0);
+
+    // GPU milliseconds spent in tuning dispatches so far
+    float spent = 0.0f;
+    const uint32_t dispatches =
+        WorkgroupTuner::WARMUP_DISPATCHES + WorkgroupTuner::TIMED_DISPATCHES;
+
+    FrameUniforms frameUniforms{};
+    frameUniforms.frameNumber = 0;
+    frameUniforms.frameDelta = 0.0f;
+    frameUniforms.renderExtent = { extent.width, extent.height };
+    // Every pixel is traced, as it is without history
+    frameUniforms.rayCounterAddress = m_TemporalCache.getCounterAddress();
+    frameUniforms.historyValid = 0;
+    frameUniforms.octreeSlot = m_OctreeSlot;
+    VkDeviceAddress frameAddress = m_FrameAllocator.push(frameUniforms).address;
+    m_FrameAllocator.flush();
+
+    for (size_t i = 0; i < m_VoxelPipelines.size(); i++)
     {
-        for (size_t i = 0; i < frameTimeSize - 1; i++)
+        if (static_cast<RaytraceMode>(i) == RaytraceMode::BruteForce) continue;
+
+        WorkgroupSize cached;
+        if (!m_Options.retuneWorkgroups &&
+            m_WorkgroupTuner.getCached(s_RaytraceModeShaders[i], cached))
+            continue;
+
+        if (spent >= WORKGROUP_TUNING_BUDGET)
         {
-            avgTime += frameTimes[i];
-            maxTime = fmin(maxTime, frameTimes[i]);
-            minTime = fmax(minTime, frameTimes[i]);
-            frameTimes[i] = frameTimes[i + 1];
+            spdlog::warn("Workgroup tuning budget spent, {} keeps {}x{}", s_RaytraceModeNames[i],
+                         m_WorkgroupSizes[i].x, m_WorkgroupSizes[i].y);
+            continue;
         }
-        avgTime += frameTimes[frameTimeSize - 1];
-        avgTime /= (float)frameTimeSize;
-    }
-    else
-    {
-        currentFrame += 1;
+
+        ShaderModule voxelShader;
+        voxelShader.create(getRaytraceShader(i), m_Device);
+
+        std::vector<VkPipeline> variants(candidates.size());
+        m_JobSystem.parallelFor(static_cast<uint32_t>(candidates.size()), 1,
+                                [&](uint32_t begin, uint32_t end) {
+                                    for (uint32_t j = begin; j < end; j++)
+                                    {
+                                        variants[j] = createVoxelPipeline(
+                                            voxelShader.getShaderModule(), candidates[j]);
+                                    }
+                                });
+
+        // Every dispatch writes the tuned corner, the first one from an undefined layout.
+        // The coarse depth image is bound but not read without a prepass.
+        ImmediateSubmit::submit([&](VkCommandBuffer commandBuffer) {
+            m_DrawImage.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                                   VK_IMAGE_LAYOUT_GENERAL);
+            m_CoarseDepthImage.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                                          VK_IMAGE_LAYOUT_GENERAL);
+        });
+
+        // Candidates left untimed once the budget runs out are dropped, the best so far wins
+        size_t best = 0;
+        float bestTime = FLT_MAX;
+        for (size_t j = 0; j < candidates.size() && spent < WORKGROUP_TUNING_BUDGET; j++)
+        {
+            float time = m_WorkgroupTuner.measure([&](VkCommandBuffer commandBuffer) {
+                dispatchRaytrace(commandBuffer, static_cast<RaytraceMode>(i), variants[j],
+                                 candidates[j], frameAddress, extent, m_VoxelDescriptorSet);
+            });
+            spdlog::info("{} {}x{}: {:.3f} ms", s_RaytraceModeNames[i], candidates[j].x,
+                         candidates[j].y, time);
+            spent += time * dispatches;
+
+            if (time < bestTime)
+            {
+                best = j;
+                bestTime = time;
+            }
+        }
+
+        vkDestroyPipeline(m_Device, m_VoxelPipelines[i], nullptr);
+        for (size_t j = 0; j < variants.size(); j++)
+        {
+            if (j != best) vkDestroyPipeline(m_Device, variants[j], nullptr);
+        }
+
+        m_VoxelPipelines[i] = variants[best];
+        m_WorkgroupSizes[i] = candidates[best];
+        m_WorkgroupTuner.setCached(s_RaytraceModeShaders[i], candidates[best]);
+        tuned = true;
+
+        spdlog::info("Tuned {} workgroup size: {}x{}", s_RaytraceModeNames[i], candidates[best].x,
+                     candidates[best].y);
     }
 
+    if (tuned) m_WorkgroupTuner.save();
+}
+
+void Engine::update(float frameDelta)
+{
+    // Input posted while polling reaches the camera before this frame's update
+    EventHandler::drain();
+
+    GameUpdate update;
+    update.frameDelta = frameDelta;
+    EventHandler::dispatch(update);
+
+    m_ChunkManager.update(glm::vec3(m_Camera.getPosition()));
+    m_World.upload(&m_JobSystem);
+    m_OctreeChanges.add(m_World.getUploadedRegion());
+    // Octree mode traces the tree, which only changes when a rebuilt one is swapped in
+    if (m_RaytraceMode != RaytraceMode::Octree) m_SceneChanges.add(m_World.getUploadedRegion());
+
+    updateOctree();
+
+    if (m_Options.headless) return;
+
+    ImGui_ImplVulkan_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+
     ImGui::NewFrame();
 
     if (ImGui::Begin("Stats"))
     {
+        const FrameSummary& summary = m_Telemetry.getSummary();
+
         ImGui::PushItemWidth(ImGui::GetWindowContentRegionMax().x - 10.0f);
         ImGui::Text("Frametime (ms)");
 
-        ImGui::PlotLines("##FrametimeGraph", frameTimes, frameTimeSize, 0, NULL, 0.0f, FLT_MAX,
-                         ImVec2(0, 80.0f));
+        ImGui::PlotLines("##FrametimeGraph", m_Telemetry.getFrameTimes(),
+                         m_Telemetry.getHistorySize(), m_Telemetry.getHistoryOffset(), NULL, 0.0f,
+                         FLT_MAX, ImVec2(0, 80.0f));
         ImGui::PopItemWidth();
 
-        ImGui::Text("MAX: %1.3f : %.3f", maxTime, 1.0f / maxTime);
-        ImGui::Text("AVG: %1.3f : %.2f", avgTime, 1.0f / avgTime);
-        ImGui::Text("MIN: %1.3f : %.2f", minTime, 1.0f / minTime);
+        ImGui::Text("AVG: %1.3f  P50: %1.3f", summary.average * 1000.0f, summary.p50 * 1000.0f);
+        ImGui::Text("P95: %1.3f  P99: %1.3f", summary.p95 * 1000.0f, summary.p99 * 1000.0f);
+        ImGui::Text("MAX: %1.3f  Hitches: %llu", summary.max * 1000.0f,
+                    static_cast<unsigned long long>(m_Telemetry.getHitchCount()));
+
+        const FrameSample& latest = m_Telemetry.getLatest();
+        ImGui::Text("CPU update: %1.3f record: %1.3f submit: %1.3f", latest.updateTime * 1000.0f,
+                    latest.recordTime * 1000.0f, latest.submitTime * 1000.0f);
+
         ImGui::Text("FPS: %1.3f", 1.0f / m_Stats.frameDelta);
+
+        bool exportEnabled = m_Telemetry.isExportEnabled();
+        if (ImGui::Checkbox("Export telemetry", &exportEnabled))
+            m_Telemetry.setExportEnabled(exportEnabled);
+
+        ImGui::Text("GPU (ms): %1.3f", m_GpuProfiler.getTotalMilliseconds());
+        for (const GpuProfiler::Region& region : m_GpuProfiler.getRegions())
+        {
+            ImGui::Text("%s: %1.3f", region.name.c_str(), region.milliseconds);
+
+            ImGui::PushItemWidth(ImGui::GetWindowContentRegionMax().x - 10.0f);
+            ImGui::PlotLines(("##" + region.name).c_str(), region.history.data(),
+                             GpuProfiler::HISTORY_SIZE, region.historyOffset, NULL, 0.0f, FLT_MAX,
+                             ImVec2(0, 40.0f));
+            ImGui::PopItemWidth();
+        }
+
+        int mode = static_cast<int>(m_RaytraceMode);
+        if (ImGui::Combo("Raytracer", &mode, s_RaytraceModeNames,
+                         static_cast<int>(RaytraceMode::Count)))
+        {
+            m_RaytraceMode = static_cast<RaytraceMode>(mode);
+            m_TemporalCache.invalidate();
+        }
+        const WorkgroupSize& workgroupSize = m_WorkgroupSizes[static_cast<size_t>(m_RaytraceMode)];
+        ImGui::Text("Workgroup: %ux%u", workgroupSize.x, workgroupSize.y);
+
+        bool dynamicResolution = m_DynamicResolution.isEnabled();
+        if (ImGui::Checkbox("Dynamic resolution", &dynamicResolution))
+            m_DynamicResolution.setEnabled(dynamicResolution);
+        float budget = m_DynamicResolution.getBudget();
+        if (ImGui::SliderFloat("GPU budget (ms)", &budget, 1.0f, 50.0f))
+            m_DynamicResolution.setBudget(budget);
+        VkExtent2D renderExtent = m_DynamicResolution.getExtent();
+        ImGui::Text("Render: %ux%u (%.0f%%)", renderExtent.width, renderExtent.height,
+                    m_DynamicResolution.getScale() * 100.0f);
+        bool traceToSwapchain = m_SwapchainStorage &&
+                                renderExtent.width == m_SwapchainImageExtent.width &&
+                                renderExtent.height == m_SwapchainImageExtent.height;
+        ImGui::Text("Target: %s", traceToSwapchain ? "swapchain" : "draw image, blit");
+
+        ImGui::Checkbox("Depth prepass", &m_Options.depthPrepass);
+
+        bool reprojection = m_TemporalCache.isEnabled();
+        if (ImGui::Checkbox("Reprojection", &reprojection))
+            m_TemporalCache.setEnabled(reprojection);
+        ImGui::Text("Rays saved: %.1f%%", m_TemporalCache.getRaysSaved() * 100.0f);
+
+        ImGui::Text("Chunks: %zu resident, %zu pending", m_ChunkManager.getResidentCount(),
+                    m_ChunkManager.getPendingCount());
+        ImGui::Text("Bricks: %u / %u", m_World.getBrickCount(), m_World.getBrickCapacity());
+        ImGui::Text("Evictions: %llu (%llu under memory pressure)",
+                    static_cast<unsigned long long>(m_ChunkManager.getEvictionCount()),
+                    static_cast<unsigned long long>(m_ChunkManager.getPressureEvictionCount()));
+        ImGui::Text("Bindless: %u / %u buffers, %u / %u images", m_BindlessHeap.getBufferCount(),
+                    m_BindlessHeap.getBufferCapacity(), m_BindlessHeap.getImageCount(),
+                    m_BindlessHeap.getImageCapacity());
+        ImGui::Text("Descriptors: %u / %u sets in %u pages", m_DescriptorAllocator.getSetCount(),
+                    m_DescriptorAllocator.getSetCapacity(), m_DescriptorAllocator.getPageCount());
+        ImGui::Text("Frame data: %.1f KB, peak %.1f / %.1f KB",
+                    m_FrameAllocator.getUsed() / 1024.0f, m_FrameAllocator.getPeakUsed() / 1024.0f,
+                    m_FrameAllocator.getRegionSize() / 1024.0f);
+        ImGui::Text("Staging: %.1f / %.1f MB", StagingRing::getUsed() / (1024.0f * 1024.0f),
+                    StagingRing::getCapacity() / (1024.0f * 1024.0f));
+
+        if (ImGui::TreeNode("Memory"))
+        {
+            const std::vector<MemoryBudget::Heap>& heaps = MemoryBudget::getHeaps();
+            for (size_t i = 0; i < heaps.size(); i++)
+            {
+                ImGui::Text("Heap %zu%s: %6.1f / %6.1f MB of %6.1f MB", i,
+                            heaps[i].deviceLocal ? " (device)" : "", heaps[i].usage / 1048576.0f,
+                            heaps[i].budget / 1048576.0f, heaps[i].size / 1048576.0f);
+            }
+            for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++)
+            {
+                MemoryCategory category = static_cast<MemoryCategory>(i);
+                ImGui::Text("%-16s %6.1f MB", MemoryBudget::getName(category),
+                            MemoryBudget::getUsage(category) / 1048576.0f);
+            }
+            if (!MemoryBudget::hasBudgetExtension()) ImGui::Text("Budgets are estimates");
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Jobs"))
+        {
+            // Worker 0 is the main thread, which only runs jobs while it waits on them
+            std::vector<WorkerStats> workers = m_JobSystem.getStats();
+            double uptime = m_JobSystem.getUptime();
+            for (size_t i = 0; i < workers.size(); i++)
+            {
+                ImGui::Text("%2zu: %8llu tasks %8llu steals %5.1f%% idle", i,
+                            static_cast<unsigned long long>(workers[i].tasksRun),
+                            static_cast<unsigned long long>(workers[i].steals),
+                            i == 0 ? 0.0 : 100.0 * workers[i].idleTime / uptime);
+            }
+            if (ImGui::Button("Reset")) m_JobSystem.resetStats();
+            ImGui::TreePop();
+        }
     }
     ImGui::End();
 
@@ -552,27 +1200,43 @@ void Engine::renderImGui(VkCommandBuffer& commandBuffer, VkImageView targetView,
 
 void Engine::render(float frameDelta)
 {
-    static uint32_t currentFrameIndex = 0;
-    int frameIndex = currentFrameIndex % FRAMES_IN_FLIGHT;
+    int frameIndex = m_FrameNumber % FRAMES_IN_FLIGHT;
     FrameData& currentFrame = m_Frames[frameIndex];
 
     VK_CHECK(vkWaitForFences(m_Device, 1, &currentFrame.renderFence, true, 1000000000));
+    m_BindlessHeap.nextFrame();
+    MemoryBudget::update(m_FrameNumber);
+    m_FrameAllocator.beginFrame(frameIndex);
+
+    // A dump copied by this slot's previous frame is complete, write it before the fence resets
+    if (m_DumpPending && m_DumpFrameIndex == static_cast<uint32_t>(frameIndex))
+        writePendingDump(false);
 
     VK_CHECK(vkResetFences(m_Device, 1, &currentFrame.renderFence));
+    TransferQueue::collect();
 
-    uint32_t swapchainImageIndex;
+    uint32_t swapchainImageIndex = 0;
+    if (!m_Options.headless)
     {
         vkAcquireNextImageKHR(m_Device, m_Swapchain, 1000000000, currentFrame.swapchainSemaphore,
                               nullptr, &swapchainImageIndex);
     }
 
+    // Frames pushed to telemetry so far, which is this frame's number
+    uint32_t frameNumber = static_cast<uint32_t>(m_Telemetry.getFrameCount());
+    bool dumpFrame = m_Options.headless && m_Options.dumpInterval > 0 &&
+                     frameNumber % m_Options.dumpInterval == 0;
+    if (dumpFrame) writePendingDump(true);
+
+    // The world on the CPU is what this frame uploaded, so the reference is traced now. Octree
+    // mode renders a snapshot that is rebuilt at most once a second and can lag behind it.
+    if (dumpFrame && m_Options.cpuReference) m_CpuRaytracer.render(m_World, m_Camera);
+
+    double recordStart = getTime();
+
     VkCommandBuffer commandBuffer = currentFrame.commandBuffer;
     VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
 
-    VkExtent2D drawExtent;
-    drawExtent.width = m_DrawImage.getExtent().width;
-    drawExtent.height = m_DrawImage.getExtent().height;
-
     VkCommandBufferBeginInfo commandBufferBI{};
     commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     commandBufferBI.pNext = nullptr;
@@ -581,52 +1245,179 @@ void Engine::render(float frameDelta)
 
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBI));
 
-    m_DrawImage.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
-                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_VoxelPipeline);
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_VoxelPipelineLayout, 0,
-                            1, &m_VoxelDescriptorSet, 0, nullptr);
-
-    VoxelPushConstants pushConstants;
-    pushConstants.cameraPosition = m_Camera.getPosition();
-    pushConstants.cameraForward = m_Camera.getForward();
-    pushConstants.cameraRight = m_Camera.getRight();
-    pushConstants.cameraUp = m_Camera.getUp();
+    m_GpuProfiler.beginFrame(commandBuffer, frameIndex);
+    // Timings are from this slot's previous frame, read back by beginFrame
+    m_DynamicResolution.update(m_GpuProfiler.getTotalMilliseconds());
 
-    pushConstants.size = 1.0f;
+    VkExtent2D renderExtent = m_DynamicResolution.getExtent();
 
-    pushConstants.dimensions = { VOXEL_SIZE, VOXEL_SIZE, VOXEL_SIZE };
-    pushConstants.voxelAddress = m_VoxelBuffer.getDeviceAddress(m_Device);
+    // Without scaling the swapchain image can be traced into directly, there is nothing to blit
+    bool traceToSwapchain = m_SwapchainStorage &&
+                            renderExtent.width == m_SwapchainImageExtent.width &&
+                            renderExtent.height == m_SwapchainImageExtent.height;
+    VkDescriptorSet targetSet = m_VoxelDescriptorSet;
+    if (traceToSwapchain)
+    {
+        targetSet = m_SwapchainDescriptorSets[swapchainImageIndex];
+    }
 
-    vkCmdPushConstants(commandBuffer, m_VoxelPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
-                       sizeof(pushConstants), &pushConstants);
+    m_CoarseDepthImage.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                                  VK_IMAGE_LAYOUT_GENERAL);
+    if (traceToSwapchain)
+    {
+        Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
+                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    else
+    {
+        m_DrawImage.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_GENERAL);
+        if (!m_Options.headless)
+        {
+            Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
+                              VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        }
+    }
 
-    vkCmdDispatch(commandBuffer, std::ceil(drawExtent.width / 16.0),
-                  std::ceil(drawExtent.height / 16.0), 1);
+    m_TemporalCache.beginFrame(commandBuffer, frameIndex, m_Camera, renderExtent);
+    const Camera& previousCamera = m_TemporalCache.getPreviousCamera();
+    VkExtent2D previousExtent = m_TemporalCache.getPreviousExtent();
+
+    FrameUniforms frameUniforms;
+    frameUniforms.frameNumber = m_FrameNumber;
+    frameUniforms.frameDelta = frameDelta;
+    frameUniforms.renderExtent = { renderExtent.width, renderExtent.height };
+    frameUniforms.previousCameraPosition = previousCamera.getPosition();
+    frameUniforms.previousCameraForward = previousCamera.getForward();
+    frameUniforms.previousCameraRight = previousCamera.getRight();
+    frameUniforms.previousCameraUp = previousCamera.getUp();
+    frameUniforms.rayCounterAddress = m_TemporalCache.getCounterAddress();
+    frameUniforms.historyValid = m_TemporalCache.isHistoryValid() ? 1 : 0;
+    // In floats, the bounds of an empty region would overflow as voxel positions
+    frameUniforms.changedMin =
+        glm::vec4(glm::vec3(m_SceneChanges.min) * static_cast<float>(BRICK_SIZE), 0.0f);
+    frameUniforms.changedMax =
+        glm::vec4((glm::vec3(m_SceneChanges.max) + 1.0f) * static_cast<float>(BRICK_SIZE), 0.0f);
+    frameUniforms.previousExtent = { previousExtent.width, previousExtent.height };
+    frameUniforms.octreeSlot = m_OctreeSlot;
+    m_SceneChanges = {};
+
+    // The prepass marches the world's brick grid. Brute force does not traverse anything, and
+    // an octree older than the world can hold voxels the grid no longer has.
+    bool depthPrepass = m_Options.depthPrepass && m_RaytraceMode != RaytraceMode::BruteForce &&
+                        (m_RaytraceMode != RaytraceMode::Octree ||
+                         m_OctreeVersion == m_World.getVersion());
+    frameUniforms.coarseDepth = depthPrepass ? 1 : 0;
+    VkDeviceAddress frameAddress = m_FrameAllocator.push(frameUniforms).address;
+
+    if (m_TemporalCache.isHistoryValid())
+    {
+        // Reused hits check what moved in front of them against the splatted history
+        m_GpuProfiler.begin(commandBuffer, "Occluder Splat");
+        dispatchRaytrace(commandBuffer, m_RaytraceMode, m_OccluderSplatPipeline,
+                         OCCLUDER_SPLAT_WORKGROUP, frameAddress, previousExtent, targetSet);
+        m_GpuProfiler.end(commandBuffer);
+
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    }
 
-    m_DrawImage.transition(commandBuffer, VK_IMAGE_LAYOUT_GENERAL,
-                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    if (depthPrepass)
+    {
+        // Grid DDA push constants carry the world grid whatever mode is traced
+        VkExtent2D tiles = { (renderExtent.width + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE,
+                             (renderExtent.height + COARSE_TILE_SIZE - 1) / COARSE_TILE_SIZE };
+
+        m_GpuProfiler.begin(commandBuffer, "Depth Prepass");
+        dispatchRaytrace(commandBuffer, RaytraceMode::GridDDA, m_DepthPrepassPipeline,
+                         DEPTH_PREPASS_WORKGROUP, frameAddress, tiles, m_VoxelDescriptorSet);
+        m_GpuProfiler.end(commandBuffer);
+
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    }
 
-    VkExtent3D target = { .width = m_SwapchainImageExtent.width,
-                          .height = m_SwapchainImageExtent.height,
-                          .depth = 1 };
+    size_t mode = static_cast<size_t>(m_RaytraceMode);
+    m_GpuProfiler.begin(commandBuffer, "Raytrace");
+    dispatchRaytrace(commandBuffer, m_RaytraceMode, m_VoxelPipelines[mode], m_WorkgroupSizes[mode],
+                     frameAddress, renderExtent, targetSet);
+    m_GpuProfiler.end(commandBuffer);
+    m_TemporalCache.endFrame(commandBuffer);
 
-    Image::copyFromTo(commandBuffer, m_DrawImage.getImage(), m_SwapchainImages[swapchainImageIndex],
-                      m_DrawImage.getExtent(), target);
+    if (!traceToSwapchain)
+    {
+        m_DrawImage.transition(commandBuffer, VK_IMAGE_LAYOUT_GENERAL,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
 
-    Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
-                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    if (m_Options.headless)
+    {
+        if (dumpFrame)
+        {
+            VkBufferImageCopy copy{};
+            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.imageSubresource.layerCount = 1;
+            copy.imageExtent = m_DrawImage.getExtent();
+
+            vkCmdCopyImageToBuffer(commandBuffer, m_DrawImage.getImage(),
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   m_ReadbackBuffer.getBuffer(), 1, &copy);
+
+            memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                          VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                          VK_PIPELINE_STAGE_2_HOST_BIT,
+                          VK_ACCESS_2_HOST_READ_BIT);
+
+            m_DumpPending = true;
+            m_DumpFrame = frameNumber;
+            m_DumpFrameIndex = frameIndex;
+        }
+    }
+    else
+    {
+        if (traceToSwapchain)
+        {
+            Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
+                              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
+        else
+        {
+            VkExtent3D source = { .width = renderExtent.width,
+                                  .height = renderExtent.height,
+                                  .depth = 1 };
+            VkExtent3D target = { .width = m_SwapchainImageExtent.width,
+                                  .height = m_SwapchainImageExtent.height,
+                                  .depth = 1 };
+
+            // Linear filtering upscales the traced region to the window
+            m_GpuProfiler.begin(commandBuffer, "Blit");
+            Image::copyFromTo(commandBuffer, m_DrawImage.getImage(),
+                              m_SwapchainImages[swapchainImageIndex], source, target);
+            m_GpuProfiler.end(commandBuffer);
+
+            Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
 
-    renderImGui(commandBuffer, m_SwapchainImageViews[swapchainImageIndex], m_SwapchainImageExtent);
+        m_GpuProfiler.begin(commandBuffer, "ImGui");
+        renderImGui(commandBuffer, m_SwapchainImageViews[swapchainImageIndex],
+                    m_SwapchainImageExtent);
+        m_GpuProfiler.end(commandBuffer);
 
-    Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
-                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        Image::transition(commandBuffer, m_SwapchainImages[swapchainImageIndex],
+                          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                          VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
 
     VK_CHECK(vkEndCommandBuffer(commandBuffer));
+    m_FrameAllocator.flush();
+
+    double submitStart = getTime();
+    m_Stats.recordTime = submitStart - recordStart;
 
     VkCommandBufferSubmitInfo commandBufferSI{};
     commandBufferSI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
@@ -634,46 +1425,101 @@ void Engine::render(float frameDelta)
     commandBufferSI.commandBuffer = commandBuffer;
     commandBufferSI.deviceMask = 0;
 
-    VkSemaphoreSubmitInfo waitSI{};
-    waitSI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-    waitSI.pNext = nullptr;
-    waitSI.semaphore = currentFrame.swapchainSemaphore;
-    waitSI.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
-    waitSI.deviceIndex = 0;
-    waitSI.value = 1;
-
-    VkSemaphoreSubmitInfo signalSI{};
-    signalSI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-    signalSI.pNext = nullptr;
-    signalSI.semaphore = currentFrame.renderSemaphore;
-    signalSI.stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
-    signalSI.deviceIndex = 0;
-    signalSI.value = 1;
+    // Batched graphics-queue work is ordered before the frame by submission order
+    ImmediateSubmit::flush();
+
+    // The raytracer reads whatever was uploaded this frame, the wait stays on the GPU
+    TransferTicket uploadTicket = StagingRing::flush();
+
+    VkSemaphoreSubmitInfo waitSIs[2]{};
+    waitSIs[0] = TransferQueue::waitInfo(uploadTicket, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    waitSIs[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitSIs[1].pNext = nullptr;
+    waitSIs[1].semaphore = currentFrame.swapchainSemaphore;
+    // Tracing into the swapchain image writes it from the raytrace dispatch
+    waitSIs[1].stageMask = traceToSwapchain ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+                                            : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+    waitSIs[1].deviceIndex = 0;
+    waitSIs[1].value = 1;
+
+    VkSemaphoreSubmitInfo signalSIs[2]{};
+    signalSIs[0] = TransferQueue::releaseInfo();
+    signalSIs[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalSIs[1].pNext = nullptr;
+    signalSIs[1].semaphore = currentFrame.renderSemaphore;
+    signalSIs[1].stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
+    signalSIs[1].deviceIndex = 0;
+    signalSIs[1].value = 1;
+
+    // Without a swapchain there is no acquire to wait on and no present to signal
+    uint32_t semaphoreCount = m_Options.headless ? 1 : 2;
 
     VkSubmitInfo2 submit{};
     submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
     submit.pNext = nullptr;
-    submit.waitSemaphoreInfoCount = 1;
-    submit.pWaitSemaphoreInfos = &waitSI;
-    submit.signalSemaphoreInfoCount = 1;
-    submit.pSignalSemaphoreInfos = &signalSI;
+    submit.waitSemaphoreInfoCount = semaphoreCount;
+    submit.pWaitSemaphoreInfos = waitSIs;
+    submit.signalSemaphoreInfoCount = semaphoreCount;
+    submit.pSignalSemaphoreInfos = signalSIs;
     submit.commandBufferInfoCount = 1;
     submit.pCommandBufferInfos = &commandBufferSI;
 
     VK_CHECK(vkQueueSubmit2(m_GraphicsQueue.queue, 1, &submit, currentFrame.renderFence));
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.pNext = nullptr;
-    presentInfo.pSwapchains = &m_Swapchain;
-    presentInfo.swapchainCount = 1;
-    presentInfo.pWaitSemaphores = &currentFrame.renderSemaphore;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pImageIndices = &swapchainImageIndex;
-
+    if (!m_Options.headless)
     {
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.pNext = nullptr;
+        presentInfo.pSwapchains = &m_Swapchain;
+        presentInfo.swapchainCount = 1;
+        presentInfo.pWaitSemaphores = &currentFrame.renderSemaphore;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pImageIndices = &swapchainImageIndex;
+
         vkQueuePresentKHR(m_GraphicsQueue.queue, &presentInfo);
     }
 
-    currentFrameIndex++;
+    m_Stats.submitTime = getTime() - submitStart;
+
+    m_FrameNumber++;
+}
+
+void Engine::dispatchRaytrace(VkCommandBuffer commandBuffer, RaytraceMode mode,
+                              VkPipeline pipeline, WorkgroupSize size,
+                              VkDeviceAddress frameAddress, VkExtent2D extent,
+                              VkDescriptorSet targetSet)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    std::array<VkDescriptorSet, 3> descriptorSets = { targetSet,
+                                                      m_BindlessHeap.getSet(),
+                                                      m_TemporalCache.getSet() };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_VoxelPipelineLayout, 0,
+                            static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
+                            0, nullptr);
+
+    VoxelPushConstants pushConstants;
+    pushConstants.cameraPosition = m_Camera.getPosition();
+    pushConstants.cameraForward = m_Camera.getForward();
+    pushConstants.cameraRight = m_Camera.getRight();
+    pushConstants.cameraUp = m_Camera.getUp();
+
+    pushConstants.size = 1.0f;
+
+    pushConstants.dimensions = m_World.getDimensions();
+    pushConstants.gridOrigin = glm::ivec4(mode == RaytraceMode::Octree
+                                              ? m_Octree.getOrigin()
+                                              : m_World.getOrigin(),
+                                          0);
+    pushConstants.paletteAddress = m_World.getPalette().getBuffer().getDeviceAddress(m_Device);
+    pushConstants.brickAddress = m_World.getBrickGridBuffer().getDeviceAddress(m_Device);
+    pushConstants.frameAddress = frameAddress;
+    pushConstants.voxelAddress = m_World.getBrickPoolBuffer().getDeviceAddress(m_Device);
+
+    vkCmdPushConstants(commandBuffer, m_VoxelPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(pushConstants), &pushConstants);
+
+    vkCmdDispatch(commandBuffer, (extent.width + size.x - 1) / size.x,
+                  (extent.height + size.y - 1) / size.y, 1);
 }
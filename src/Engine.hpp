@@ -5,14 +5,31 @@
 #include "vulkan/vulkan.h"
 #include <spdlog/spdlog.h>
 
+#include <array>
+#include <string>
 #include <vector>
 
+#include "BindlessHeap.hpp"
 #include "Buffer.hpp"
 #include "Camera.hpp"
+#include "ChunkManager.hpp"
+#include "CpuRaytracer.hpp"
+#include "Descriptors.hpp"
+#include "DynamicResolution.hpp"
 #include "EventHandler.hpp"
 #include "Events.hpp"
+#include "FrameAllocator.hpp"
+#include "FrameTelemetry.hpp"
+#include "GpuProfiler.hpp"
 #include "Image.hpp"
+#include "JobSystem.hpp"
+#include "Octree.hpp"
+#include "PipelineCache.hpp"
+#include "TemporalCache.hpp"
+#include "Voxel.hpp"
 #include "Window.hpp"
+#include "WorkgroupTuner.hpp"
+#include "World.hpp"
 
 struct Queue {
     VkQueue queue;
@@ -28,9 +45,7 @@ struct FrameData {
     VkFence renderFence;
 };
 
-struct Voxel {
-    glm::vec4 colour;
-};
+enum class RaytraceMode : uint32_t { BruteForce, GridDDA, Brickmap, Octree, Count };
 
 struct VoxelPushConstants {
     glm::vec4 cameraPosition;
@@ -39,11 +54,78 @@ struct VoxelPushConstants {
     glm::vec4 cameraUp;
     glm::uvec3 dimensions;
     float size;
+    glm::ivec4 gridOrigin;
+    // Brick pool, the octree is read through the bindless heap instead
     VkDeviceAddress voxelAddress;
+    VkDeviceAddress paletteAddress;
+    VkDeviceAddress brickAddress;
+    // FrameUniforms of this frame, in the frame allocator
+    VkDeviceAddress frameAddress;
+};
+static_assert(sizeof(VoxelPushConstants) <= 128, "Push constants past the guaranteed 128 bytes");
+
+// Per-frame data that does not fit in the push constants
+struct FrameUniforms {
+    uint32_t frameNumber;
+    float frameDelta;
+    // Region of the draw image traced this frame, from the top left corner
+    glm::uvec2 renderExtent;
+    // Camera the temporal cache's history was traced with
+    glm::vec4 previousCameraPosition;
+    glm::vec4 previousCameraForward;
+    glm::vec4 previousCameraRight;
+    glm::vec4 previousCameraUp;
+    VkDeviceAddress rayCounterAddress;
+    uint32_t historyValid;
+    // Whether the depth prepass ran for this frame's scene
+    uint32_t coarseDepth;
+    // Box in voxels the scene changed in since the history was traced, empty when min > max
+    glm::vec4 changedMin;
+    glm::vec4 changedMax;
+    // Region the history was traced at, dynamic resolution changes it between frames
+    glm::uvec2 previousExtent;
+    // Bindless heap slot of the octree nodes
+    uint32_t octreeSlot;
+};
+
+struct EngineOptions {
+    // Renders into the draw image only, without a window, surface or swapchain
+    bool headless = false;
+    uint32_t width = 500;
+    uint32_t height = 500;
+
+    // Headless only: frames along the scripted camera path and where their timings go
+    uint32_t frames = 1000;
+    std::string timingsPath = "headless_timings.csv";
+    // Writes the draw image as a PPM every dumpInterval frames, 0 disables dumps
+    uint32_t dumpInterval = 0;
+    std::string dumpPrefix = "frame_";
+    // Also traces every dumped frame on the CPU and reports how many pixels differ
+    bool cpuReference = false;
+
+    // Times every workgroup size again even when the device has cached ones
+    bool retuneWorkgroups = false;
+
+    // GPU frame time dynamic resolution scales the trace to hold, 0 disables it. Headless runs
+    // always trace at full size so dumps and timings stay comparable.
+    float gpuBudget = 16.0f;
+
+    // Reuses last frame's primary hits where they are still visible. Always off when dumps are
+    // compared against the CPU reference.
+    bool reprojection = true;
+    // Traces a conservative start distance per tile before the full resolution rays
+    bool depthPrepass = true;
+    // Traces straight into the swapchain images when the surface allows storage use and the
+    // frame is traced at the window's size, instead of blitting the draw image
+    bool traceToSwapchain = true;
 };
 
 struct Stats {
     float frameDelta;
+    // CPU time spent in update(), recording the frame, and submitting and presenting it
+    float updateTime = 0.0f;
+    float recordTime = 0.0f;
+    float submitTime = 0.0f;
 };
 
 class Engine
@@ -52,24 +134,28 @@ class Engine
   public:
     Engine() {}
 
-    void init();
+    void init(const EngineOptions& options = {});
     void start();
     void cleanup();
 
   private:
     const uint32_t FRAMES_IN_FLIGHT = 2;
 
+    EngineOptions m_Options;
+
     Camera m_Camera;
 
     Window m_Window;
 
     VkInstance m_Instance;
     VkDebugUtilsMessengerEXT m_DebugMessenger;
-    VkSurfaceKHR m_Surface;
+    VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
     VkPhysicalDevice m_PhysicalDevice;
     VkDevice m_Device;
 
     Queue m_GraphicsQueue;
+    // Dedicated transfer family when the device has one, the graphics queue otherwise
+    Queue m_TransferQueue;
 
     VmaAllocator m_Allocator;
 
@@ -78,30 +164,123 @@ class Engine
     VkSwapchainKHR m_Swapchain;
     std::vector<VkImage> m_SwapchainImages;
     std::vector<VkImageView> m_SwapchainImageViews;
+    // Whether the swapchain images were created with storage usage, which needs the
+    // raytracers built without a format on their target
+    bool m_SwapchainStorage = false;
+    bool m_StorageWriteWithoutFormat = false;
 
+    // Allocated at the full size, dynamic resolution traces a corner of it
     Image m_DrawImage;
+    DynamicResolution m_DynamicResolution;
+    TemporalCache m_TemporalCache;
+
+    // Per-tile start distances, must match coarse_depth.glsl
+    Image m_CoarseDepthImage;
+    const uint32_t COARSE_TILE_SIZE = 8;
 
+    // Headless image dumps, read back once the frame that copied them has finished
+    Buffer m_ReadbackBuffer;
+    bool m_DumpPending = false;
+    uint32_t m_DumpFrame = 0;
+    uint32_t m_DumpFrameIndex = 0;
+    CpuRaytracer m_CpuRaytracer;
+
+    // Writes the draw image
     VkDescriptorSet m_VoxelDescriptorSet;
+    // Same layout writing each swapchain image, indexed by the acquired image
+    std::vector<VkDescriptorSet> m_SwapchainDescriptorSets;
+    DescriptorAllocator m_SwapchainDescriptorAllocator;
     VkDescriptorSetLayout m_VoxelDescriptorSetLayout;
 
-    VkPipeline m_VoxelPipeline;
+    PipelineCache m_PipelineCache;
+    const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+    WorkgroupTuner m_WorkgroupTuner;
+    const char* WORKGROUP_CACHE_PATH = "workgroup_sizes.txt";
+    // Candidates are timed on at most this corner of the draw image, and tuning stops once the
+    // timed dispatches add up to the budget so a slow device cannot stall startup
+    const VkExtent2D WORKGROUP_TUNING_EXTENT = { 256, 256 };
+    const float WORKGROUP_TUNING_BUDGET = 1000.0f;
+
+    std::array<VkPipeline, static_cast<size_t>(RaytraceMode::Count)> m_VoxelPipelines;
+    std::array<WorkgroupSize, static_cast<size_t>(RaytraceMode::Count)> m_WorkgroupSizes;
     VkPipelineLayout m_VoxelPipelineLayout;
+    // Shares the voxel pipeline layout and push constants
+    VkPipeline m_DepthPrepassPipeline;
+    const WorkgroupSize DEPTH_PREPASS_WORKGROUP = { 8, 8 };
+    // Scatters the temporal cache's history into this frame's occluders, same layout again
+    VkPipeline m_OccluderSplatPipeline;
+    const WorkgroupSize OCCLUDER_SPLAT_WORKGROUP = { 8, 8 };
+    RaytraceMode m_RaytraceMode = RaytraceMode::Octree;
 
     std::vector<FrameData> m_Frames;
 
-    VkDescriptorPool m_DescriptorPool;
+    FrameAllocator m_FrameAllocator;
+    const VkDeviceSize FRAME_ALLOCATOR_REGION_SIZE = 1024 * 1024;
 
-    VkDescriptorPool m_ImguiPool;
+    DescriptorAllocator m_DescriptorAllocator;
+    const uint32_t DESCRIPTOR_PAGE_SETS = 16;
 
-    const uint32_t VOXEL_SIZE = 8;
-    size_t m_TotalVoxels;
-    Buffer m_VoxelBuffer;
+    BindlessHeap m_BindlessHeap;
+    const uint32_t BINDLESS_BUFFER_CAPACITY = 16384;
+    const uint32_t BINDLESS_IMAGE_CAPACITY = 4096;
+    // Bound beside the heap by the voxel pipeline layout: the target and coarse depth in set 0,
+    // the temporal cache's history and occluders in set 2
+    const uint32_t VOXEL_LAYOUT_STORAGE_IMAGES = 5;
+
+    VkDescriptorPool m_ImguiPool;
+    const uint32_t IMGUI_DESCRIPTOR_SETS = 16;
+
+    // World window in bricks, each axis a power of two and a multiple of CHUNK_BRICKS
+    const glm::uvec3 WORLD_GRID_SIZE = { 64, 16, 64 };
+    const uint32_t BRICK_CAPACITY = 16384;
+    const VkDeviceSize STAGING_RING_SIZE = 32 * 1024 * 1024;
+    const uint32_t VIEW_DISTANCE = 6;
+
+    JobSystem m_JobSystem;
+
+    World m_World;
+    ChunkManager m_ChunkManager;
+
+    // The rendered tree is in m_OctreeBuffers[m_OctreeCurrent]. The other buffer holds the tree
+    // before the last swap until the frames reading it have finished.
+    Octree m_Octree;
+    std::array<Buffer, 2> m_OctreeBuffers;
+    uint32_t m_OctreeCurrent = 0;
+    uint32_t m_OctreeSwapFrame = 0;
+    // The octree raytracer reads the current tree through this slot of the bindless heap
+    BindlessHeap::Slot m_OctreeSlot = BindlessHeap::INVALID_SLOT;
+    uint64_t m_OctreeVersion = 0;
+
+    // Rebuilds run as a background job over a CPU copy of the world taken when they start
+    World m_OctreeSource;
+    Octree m_PendingOctree;
+    JobCounter m_OctreeJob;
+    bool m_OctreeBuilding = false;
+    double m_OctreeBuildTime = 0.0;
+    // World bricks changed since the snapshot was taken, and between the last two snapshots
+    BrickRegion m_OctreeChanges;
+    BrickRegion m_OctreeBuildChanges;
+
+    // Bricks the traced scene changed in since the last rendered frame, the temporal cache
+    // re-traces the pixels whose reused hit lies behind them
+    BrickRegion m_SceneChanges;
+
+    // Frames rendered so far
+    uint32_t m_FrameNumber = 0;
 
     Stats m_Stats;
+    FrameTelemetry m_Telemetry;
+    const char* TELEMETRY_EXPORT_PATH = "telemetry.csv";
+    const float TELEMETRY_EXPORT_INTERVAL = 10.0f;
+    GpuProfiler m_GpuProfiler;
 
   private:
     void initVulkan();
 
+    void runHeadless();
+    void writePendingDump(bool wait);
+
     void createSwapchain();
     void initSwapchain();
     void destroySwapchain();
@@ -111,16 +290,33 @@ class Engine
 
     void initImGui();
 
-    void initVoxelBuffer();
+    void initWorld();
+    // Starts a rebuild when the world changed, and swaps in a finished one
+    void updateOctree();
+    // Uploads the pending tree into the spare buffer and renders it from then on
+    void swapOctree(uint64_t version);
 
-    void initDescriptorPool();
+    void initDescriptorAllocators();
     void initDescriptorLayouts();
 
     void initPipelines();
+    VkPipeline createVoxelPipeline(VkShaderModule shader, WorkgroupSize size);
+    // Path of the mode's raytracer build that can write every target image in use
+    const char* getRaytraceShader(size_t mode) const;
+    // Times every candidate workgroup size on the starting view for modes the cache lacks.
+    // Brute force keeps the default size, it is far too slow to dispatch repeatedly.
+    void tuneWorkgroupSizes();
 
     void initDescriptorSets();
+    // Rebuilds the per swapchain image sets, call again whenever the swapchain is recreated
+    void createSwapchainDescriptorSets();
 
     void update(float frameDelta);
     void renderImGui(VkCommandBuffer& commandBuffer, VkImageView targetView, VkExtent2D extent);
     void render(float frameDelta);
+    // Traces the top left extent of the target set's image, frameAddress holds matching
+    // FrameUniforms
+    void dispatchRaytrace(VkCommandBuffer commandBuffer, RaytraceMode mode, VkPipeline pipeline,
+                          WorkgroupSize size, VkDeviceAddress frameAddress, VkExtent2D extent,
+                          VkDescriptorSet targetSet);
 };
@@ -1,33 +1,93 @@
 #include "EventHandler.hpp"
 
-#include "Events.hpp"
+#include <spdlog/spdlog.h>
 
-std::map<EventType, std::set<EventReceiver*>> EventHandler::s_Receivers;
+#include <cstdint>
 
-void EventHandler::dispatchEvent(const Event* event)
-{
-    EventType type = event->getType();
-    auto it = s_Receivers.find(type);
+static_assert((EventHandler::QUEUE_CAPACITY & (EventHandler::QUEUE_CAPACITY - 1)) == 0,
+              "Queue capacity must be a power of two");
+
+std::array<std::vector<EventHandler::Handler>, static_cast<size_t>(EventType::Count)>
+    EventHandler::s_Handlers;
 
-    if (it == s_Receivers.end()) return;
+std::array<EventHandler::Cell, EventHandler::QUEUE_CAPACITY> EventHandler::s_Queue;
+std::atomic<size_t> EventHandler::s_Head = 0;
+size_t EventHandler::s_Tail = 0;
+std::atomic<bool> EventHandler::s_FullWarning = false;
 
-    std::set<EventReceiver*>& receivers = it->second;
-    for (EventReceiver* receiver : receivers)
+void EventHandler::init()
+{
+    for (size_t i = 0; i < QUEUE_CAPACITY; i++)
     {
-        receiver->receive(event);
+        s_Queue[i].sequence.store(i, std::memory_order_relaxed);
     }
+    s_Head.store(0, std::memory_order_release);
+    s_Tail = 0;
 }
 
-void EventHandler::subscribe(EventType event, EventReceiver* receiver)
+void EventHandler::drain()
+{
+    // Only what was posted up to now, so a handler that posts cannot keep the loop going
+    size_t end = s_Head.load(std::memory_order_acquire);
+
+    while (s_Tail != end)
+    {
+        Cell& cell = s_Queue[s_Tail & (QUEUE_CAPACITY - 1)];
+
+        // The slot is claimed but its producer has not finished writing it yet
+        if (cell.sequence.load(std::memory_order_acquire) != s_Tail + 1) break;
+
+        EventType type = cell.type;
+        alignas(std::max_align_t) unsigned char data[MAX_EVENT_SIZE];
+        memcpy(data, cell.data, MAX_EVENT_SIZE);
+
+        cell.sequence.store(s_Tail + QUEUE_CAPACITY, std::memory_order_release);
+        s_Tail++;
 
+        dispatch(type, data);
+    }
+
+    s_FullWarning.store(false, std::memory_order_relaxed);
+}
+
+void EventHandler::dispatch(EventType type, const void* event)
 {
-    s_Receivers[event].insert(receiver);
+    for (const Handler& handler : s_Handlers[static_cast<size_t>(type)])
+    {
+        handler.function(handler.receiver, event);
+    }
 }
 
-void EventHandler::subscribe(std::initializer_list<EventType> events, EventReceiver* receiver)
+bool EventHandler::post(EventType type, const void* event, size_t size)
 {
-    for (EventType event : events)
+    size_t position = s_Head.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true)
     {
-        subscribe(event, receiver);
+        cell = &s_Queue[position & (QUEUE_CAPACITY - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (difference == 0)
+        {
+            if (s_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            if (!s_FullWarning.exchange(true))
+                spdlog::warn("Event queue full, dropping events until it is drained");
+            return false;
+        }
+        else
+        {
+            position = s_Head.load(std::memory_order_relaxed);
+        }
     }
+
+    cell->type = type;
+    memcpy(cell->data, event, size);
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    return true;
 }
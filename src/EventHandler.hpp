@@ -1,26 +1,90 @@
 #pragma once
 
-#include <memory>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
-#include <initializer_list>
-#include <map>
-#include <set>
-
-enum class EventType;
-struct Event;
-class EventReceiver;
+#include "Events.hpp"
 
+// Handlers are kept in one dense array per event type and called through a plain function
+// pointer. Events can be dispatched right away on the main thread, or posted from any thread
+// into a bounded lock-free queue that the main thread drains once per frame.
 class EventHandler
 {
   public:
-    static void dispatchEvent(const Event* event);
+    static const size_t QUEUE_CAPACITY = 4096;
+    static const size_t MAX_EVENT_SIZE = 32;
+
+  public:
+    static void init();
+
+    // Calls receiver->receive(const E&) for every event of type E. Main thread only.
+    template<typename E, typename R>
+    static void subscribe(R* receiver)
+    {
+        s_Handlers[static_cast<size_t>(E::TYPE)].push_back(
+            { receiver, [](void* receiver, const void* event) {
+                 static_cast<R*>(receiver)->receive(*static_cast<const E*>(event));
+             } });
+    }
+
+    template<typename E, typename R>
+    static void unsubscribe(R* receiver)
+    {
+        std::erase_if(s_Handlers[static_cast<size_t>(E::TYPE)],
+                      [&](const Handler& handler) { return handler.receiver == receiver; });
+    }
+
+    // Calls the handlers right away, main thread only
+    template<typename E>
+    static void dispatch(const E& event)
+    {
+        dispatch(E::TYPE, &event);
+    }
+
+    // Queues the event for the next drain, safe from any thread. Returns false and drops the
+    // event when the queue is full.
+    template<typename E>
+    static bool post(const E& event)
+    {
+        static_assert(std::is_trivially_copyable_v<E>, "Queued events are copied bytewise");
+        static_assert(sizeof(E) <= MAX_EVENT_SIZE && alignof(E) <= alignof(std::max_align_t));
 
-    static void subscribe(EventType event, EventReceiver* receiver);
-    static void subscribe(std::initializer_list<EventType> events, EventReceiver* receiver);
+        return post(E::TYPE, &event, sizeof(E));
+    }
+
+    // Dispatches the events posted before the call in posting order, events posted by the
+    // handlers wait for the next drain. Main thread only.
+    static void drain();
 
   private:
     EventHandler() {}
 
   private:
-    static std::map<EventType, std::set<EventReceiver*>> s_Receivers;
+    struct Handler {
+        void* receiver;
+        void (*function)(void* receiver, const void* event);
+    };
+
+    // Sequence numbers tell producers and the consumer whose turn a cell is, after Vyukov's
+    // bounded queue
+    struct Cell {
+        std::atomic<size_t> sequence;
+        EventType type;
+        alignas(std::max_align_t) unsigned char data[MAX_EVENT_SIZE];
+    };
+
+    static std::array<std::vector<Handler>, static_cast<size_t>(EventType::Count)> s_Handlers;
+
+    static std::array<Cell, QUEUE_CAPACITY> s_Queue;
+    static std::atomic<size_t> s_Head;
+    static size_t s_Tail;
+    static std::atomic<bool> s_FullWarning;
+
+  private:
+    static void dispatch(EventType type, const void* event);
+    static bool post(EventType type, const void* event, size_t size);
 };
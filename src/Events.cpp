@@ -1,5 +0,0 @@
-#include "Events.hpp"
-
-EventReceiver::~EventReceiver() {}
-
-void EventReceiver::receive(const Event* event) {}
@@ -4,48 +4,51 @@
 
 #include <cstdint>
 
-#include "EventHandler.hpp"
-
-enum class EventType { UNDEFINED, KeyboardInput, MouseMove, GameUpdate, GameRender };
-
-struct Event {
-    virtual ~Event() = default;
-    virtual EventType getType() const { return EventType::UNDEFINED; }
+enum class EventType : uint32_t {
+    KeyboardInput,
+    MouseMove,
+    GameUpdate,
+    GameRender,
+    MemoryPressure,
+    Count
 };
 
-struct KeyboardInput : public Event {
+// Events are plain structs that name their type, so they can be copied through the event queue
+struct KeyboardInput {
+    static constexpr EventType TYPE = EventType::KeyboardInput;
+
     int32_t key;
     int32_t scancode;
     int32_t action;
     int32_t mods;
-
-    EventType getType() const override { return EventType::KeyboardInput; }
 };
 
-struct MouseMove : public Event {
-    EventType getType() const override { return EventType::MouseMove; }
+struct MouseMove {
+    static constexpr EventType TYPE = EventType::MouseMove;
 
     glm::vec2 position;
     glm::vec2 delta;
     bool captured;
 };
 
-struct GameUpdate : public Event {
-    EventType getType() const override { return EventType::GameUpdate; }
+struct GameUpdate {
+    static constexpr EventType TYPE = EventType::GameUpdate;
 
     float frameDelta;
 };
 
-struct GameRender : public Event {
-    EventType getType() const override { return EventType::GameRender; }
+struct GameRender {
+    static constexpr EventType TYPE = EventType::GameRender;
 
     float frameDelta;
 };
 
-class EventReceiver
-{
-  public:
-    virtual ~EventReceiver();
+// A device local heap is past MemoryBudget::PRESSURE_THRESHOLD of its budget. Sent when it
+// crosses the threshold and again only when its usage grows further.
+struct MemoryPressure {
+    static constexpr EventType TYPE = EventType::MemoryPressure;
 
-    virtual void receive(const Event* event);
+    uint32_t heap;
+    uint64_t usage;
+    uint64_t budget;
 };
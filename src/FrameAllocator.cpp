@@ -0,0 +1,82 @@
+#include "FrameAllocator.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+void FrameAllocator::create(VmaAllocator allocator, VkDevice device,
+                            VkPhysicalDevice physicalDevice, VkDeviceSize regionSize,
+                            uint32_t framesInFlight)
+{
+    m_Allocator = allocator;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // Offsets bound as uniform or storage buffers need the device alignment, device addresses
+    // of buffer_reference blocks need their own, 16 covers vec4 members
+    m_Alignment = std::max({ properties.limits.minUniformBufferOffsetAlignment,
+                             properties.limits.minStorageBufferOffsetAlignment,
+                             static_cast<VkDeviceSize>(16) });
+
+    m_RegionSize = (regionSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+
+    m_Buffer.create(allocator, m_RegionSize * framesInFlight,
+                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                    VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Frame);
+    m_Mapped = static_cast<uint8_t*>(m_Buffer.getAllocationInfo().pMappedData);
+    m_Address = m_Buffer.getDeviceAddress(device);
+
+    m_RegionStart = 0;
+    m_Head = 0;
+    m_PeakUsed = 0;
+
+    spdlog::info("Created Frame Allocator: {} regions of {} bytes", framesInFlight,
+                 m_RegionSize);
+}
+
+void FrameAllocator::free()
+{
+    m_Buffer.free();
+    m_Mapped = nullptr;
+    m_Address = 0;
+}
+
+void FrameAllocator::beginFrame(uint32_t frameIndex)
+{
+    m_RegionStart = frameIndex * m_RegionSize;
+    m_Head = m_RegionStart;
+}
+
+void FrameAllocator::flush()
+{
+    // No-op on coherent memory
+    if (m_Head > m_RegionStart)
+    {
+        vmaFlushAllocation(m_Allocator, m_Buffer.getAllocation(), m_RegionStart,
+                           m_Head - m_RegionStart);
+    }
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    alignment = std::max(alignment, m_Alignment);
+    VkDeviceSize offset = (m_Head + alignment - 1) / alignment * alignment;
+
+    if (offset + size > m_RegionStart + m_RegionSize)
+    {
+        if (!m_FullWarning)
+        {
+            spdlog::warn("Frame allocator region full ({} bytes), raise its size",
+                         m_RegionSize);
+            m_FullWarning = true;
+        }
+        return {};
+    }
+
+    m_Head = offset + size;
+    m_PeakUsed = std::max(m_PeakUsed, m_Head - m_RegionStart);
+
+    return { .data = m_Mapped + offset, .offset = offset, .address = m_Address + offset };
+}
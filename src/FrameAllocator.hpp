@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#include "Buffer.hpp"
+
+struct FrameAllocation {
+    // Write through this, nullptr when the frame's region is full
+    void* data = nullptr;
+    VkDeviceSize offset = 0;
+    VkDeviceAddress address = 0;
+};
+
+// Persistently mapped host-visible buffer split into one region per frame in flight. Per-frame
+// data is bump allocated from the current region and read by shaders through its device address
+// or as an offset into getBuffer(), so it needs no allocation and no descriptor update. A region
+// is reused once its frame's fence has signalled.
+class FrameAllocator
+{
+  public:
+    FrameAllocator() {}
+    FrameAllocator(FrameAllocator&) = delete;
+    FrameAllocator(FrameAllocator&&) = delete;
+
+    void create(VmaAllocator allocator, VkDevice device, VkPhysicalDevice physicalDevice,
+                VkDeviceSize regionSize, uint32_t framesInFlight);
+    void free();
+
+    // Call after waiting on the frame's fence, before allocating for it
+    void beginFrame(uint32_t frameIndex);
+    // Makes the frame's writes visible to the device, call before submitting it
+    void flush();
+
+    // Aligned to at least the device's uniform and storage buffer offset alignment
+    FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+    template<typename T>
+    FrameAllocation push(const T& value)
+    {
+        return push(std::span<const T>(&value, 1));
+    }
+
+    template<typename T>
+    FrameAllocation push(std::span<const T> values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Frame data is copied bytewise");
+
+        FrameAllocation allocation = allocate(values.size_bytes(), alignof(T));
+        if (allocation.data != nullptr) memcpy(allocation.data, values.data(), values.size_bytes());
+        return allocation;
+    }
+
+    VkBuffer getBuffer() const { return m_Buffer.getBuffer(); }
+    VkDeviceSize getRegionSize() const { return m_RegionSize; }
+    VkDeviceSize getUsed() const { return m_Head - m_RegionStart; }
+    // Largest amount a single frame has used since creation
+    VkDeviceSize getPeakUsed() const { return m_PeakUsed; }
+
+  private:
+    VmaAllocator m_Allocator;
+    Buffer m_Buffer;
+    uint8_t* m_Mapped = nullptr;
+    VkDeviceAddress m_Address = 0;
+
+    VkDeviceSize m_RegionSize = 0;
+    VkDeviceSize m_Alignment = 16;
+
+    VkDeviceSize m_RegionStart = 0;
+    VkDeviceSize m_Head = 0;
+    VkDeviceSize m_PeakUsed = 0;
+    bool m_FullWarning = false;
+};
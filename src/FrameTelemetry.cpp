@@ -0,0 +1,157 @@
+#include "FrameTelemetry.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <fstream>
+
+void FrameTelemetry::push(const FrameSample& sample)
+{
+    // Judged against the median before this frame is part of it
+    if (m_Count >= 30 && sample.frameTime > m_Summary.p50 * HITCH_FACTOR) m_HitchCount++;
+
+    m_Samples[m_Head] = sample;
+    m_FrameTimes[m_Head] = sample.frameTime;
+    m_Head = (m_Head + 1) % CAPACITY;
+    m_Count = std::min(m_Count + 1, CAPACITY);
+    m_FrameCount++;
+
+    updateSummary();
+
+    if (!m_ExportEnabled || m_ExportPath.empty()) return;
+
+    m_SinceExport += sample.frameTime;
+    if (m_SinceExport >= m_ExportInterval)
+    {
+        m_SinceExport = 0.0f;
+        exportNow();
+    }
+}
+
+void FrameTelemetry::setExport(const std::string& path, float interval)
+{
+    m_ExportPath = path;
+    m_ExportInterval = interval;
+    m_SinceExport = 0.0f;
+    m_JsonSamples.clear();
+}
+
+bool FrameTelemetry::exportNow()
+{
+    if (m_ExportPath.ends_with(".json")) return exportJson();
+    return exportCsv();
+}
+
+const FrameSample& FrameTelemetry::getLatest() const
+{
+    return m_Samples[(m_Head + CAPACITY - 1) % CAPACITY];
+}
+
+void FrameTelemetry::updateSummary()
+{
+    // Entries past m_Count are unused until the window fills, the head starts at zero
+    float* first = m_Scratch.data();
+    float* last = first + m_Count;
+    std::copy_n(m_FrameTimes.begin(), m_Count, first);
+
+    // Each selection partitions the scratch, so the next one only searches above it
+    auto percentile = [&](float p, float* from) {
+        float* nth = first + static_cast<size_t>(p * (m_Count - 1) + 0.5f);
+        std::nth_element(from, nth, last);
+        return nth;
+    };
+
+    float sum = 0.0f;
+    for (float* it = first; it != last; it++)
+    {
+        sum += *it;
+    }
+
+    // Values are read right away, later selections reorder the range they start in
+    m_Summary.average = sum / m_Count;
+    float* nth = percentile(0.50f, first);
+    m_Summary.p50 = *nth;
+    nth = percentile(0.95f, nth);
+    m_Summary.p95 = *nth;
+    nth = percentile(0.99f, nth);
+    m_Summary.p99 = *nth;
+    m_Summary.max = *std::max_element(nth, last);
+}
+
+bool FrameTelemetry::exportCsv()
+{
+    bool writeHeader = m_ExportedFrames == 0;
+    std::ofstream file(m_ExportPath, writeHeader ? std::ios::trunc : std::ios::app);
+    if (!file.is_open())
+    {
+        spdlog::error("Failed to open telemetry export {}", m_ExportPath);
+        return false;
+    }
+
+    if (writeHeader) file << "frame,frame_ms,update_ms,record_ms,submit_ms,gpu_ms\n";
+
+    // Frames that already left the window are lost
+    uint64_t pending = std::min<uint64_t>(m_FrameCount - m_ExportedFrames, m_Count);
+    for (uint64_t i = 0; i < pending; i++)
+    {
+        uint64_t frame = m_FrameCount - pending + i;
+        const FrameSample& sample = m_Samples[(m_Head + CAPACITY - pending + i) % CAPACITY];
+        file << frame << ',' << sample.frameTime * 1000.0f << ',' << sample.updateTime * 1000.0f
+             << ',' << sample.recordTime * 1000.0f << ',' << sample.submitTime * 1000.0f << ','
+             << sample.gpuTime * 1000.0f << '\n';
+    }
+
+    m_ExportedFrames = m_FrameCount;
+    spdlog::info("Exported {} frames of telemetry to {}", pending, m_ExportPath);
+
+    return true;
+}
+
+bool FrameTelemetry::exportJson()
+{
+    // Frames that already left the window are lost
+    uint64_t pending = std::min<uint64_t>(m_FrameCount - m_ExportedFrames, m_Count);
+    for (uint64_t i = 0; i < pending; i++)
+    {
+        uint64_t frame = m_FrameCount - pending + i;
+        m_JsonSamples.emplace_back(frame,
+                                   m_Samples[(m_Head + CAPACITY - pending + i) % CAPACITY]);
+    }
+    m_ExportedFrames = m_FrameCount;
+
+    std::ofstream file(m_ExportPath, std::ios::trunc);
+    if (!file.is_open())
+    {
+        spdlog::error("Failed to open telemetry export {}", m_ExportPath);
+        return false;
+    }
+
+    file << "{\n";
+    file << "  \"frames\": " << m_FrameCount << ",\n";
+    file << "  \"hitches\": " << m_HitchCount << ",\n";
+    // The summary covers the latest window, the samples every exported frame
+    file << "  \"summary_frames\": " << m_Count << ",\n";
+    file << "  \"summary_ms\": { \"average\": " << m_Summary.average * 1000.0f
+         << ", \"p50\": " << m_Summary.p50 * 1000.0f << ", \"p95\": " << m_Summary.p95 * 1000.0f
+         << ", \"p99\": " << m_Summary.p99 * 1000.0f << ", \"max\": " << m_Summary.max * 1000.0f
+         << " },\n";
+    // Same fields as the CSV columns
+    file << "  \"samples\": [\n";
+
+    for (size_t i = 0; i < m_JsonSamples.size(); i++)
+    {
+        const auto& [frame, sample] = m_JsonSamples[i];
+        file << "    { \"frame\": " << frame << ", \"frame_ms\": " << sample.frameTime * 1000.0f
+             << ", \"update_ms\": " << sample.updateTime * 1000.0f
+             << ", \"record_ms\": " << sample.recordTime * 1000.0f
+             << ", \"submit_ms\": " << sample.submitTime * 1000.0f
+             << ", \"gpu_ms\": " << sample.gpuTime * 1000.0f << " }"
+             << (i + 1 < m_JsonSamples.size() ? ",\n" : "\n");
+    }
+
+    file << "  ]\n}\n";
+
+    spdlog::info("Exported {} frames of telemetry to {}", m_JsonSamples.size(), m_ExportPath);
+
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Timings of one frame, all in seconds
+struct FrameSample {
+    float frameTime = 0.0f;
+    float updateTime = 0.0f;
+    float recordTime = 0.0f;
+    float submitTime = 0.0f;
+    float gpuTime = 0.0f;
+};
+
+struct FrameSummary {
+    float average = 0.0f;
+    float p50 = 0.0f;
+    float p95 = 0.0f;
+    float p99 = 0.0f;
+    float max = 0.0f;
+};
+
+// Rolling window of frame timings with percentiles and hitch counting. Samples can be exported
+// periodically, and each export takes the frames recorded since the previous one: CSV appends
+// them, JSON keeps them and rewrites the file with every frame exported so far. Exports must
+// come at least every CAPACITY frames or frames fall out of the window first.
+class FrameTelemetry
+{
+  public:
+    static const uint32_t CAPACITY = 1024;
+    // A frame counts as a hitch when it takes this many times the rolling median
+    static constexpr float HITCH_FACTOR = 2.0f;
+
+  public:
+    FrameTelemetry() {}
+    FrameTelemetry(FrameTelemetry&) = delete;
+    FrameTelemetry(FrameTelemetry&&) = delete;
+
+    void push(const FrameSample& sample);
+
+    // Format is picked from the extension, .json or .csv
+    void setExport(const std::string& path, float interval);
+    void setExportEnabled(bool enabled) { m_ExportEnabled = enabled; }
+    bool isExportEnabled() const { return m_ExportEnabled; }
+    bool exportNow();
+
+    const FrameSummary& getSummary() const { return m_Summary; }
+    const FrameSample& getLatest() const;
+    uint64_t getHitchCount() const { return m_HitchCount; }
+    uint64_t getFrameCount() const { return m_FrameCount; }
+
+    // Frame times in recording order starting at getHistoryOffset(), for plotting
+    const float* getFrameTimes() const { return m_FrameTimes.data(); }
+    uint32_t getHistorySize() const { return CAPACITY; }
+    uint32_t getHistoryOffset() const { return m_Head; }
+
+  private:
+    std::array<FrameSample, CAPACITY> m_Samples;
+    std::array<float, CAPACITY> m_FrameTimes{};
+    // Reused by every summary update for the percentile selection
+    std::array<float, CAPACITY> m_Scratch;
+    uint32_t m_Head = 0;
+    uint32_t m_Count = 0;
+    uint64_t m_FrameCount = 0;
+
+    FrameSummary m_Summary;
+    uint64_t m_HitchCount = 0;
+
+    std::string m_ExportPath;
+    float m_ExportInterval = 10.0f;
+    float m_SinceExport = 0.0f;
+    bool m_ExportEnabled = false;
+    uint64_t m_ExportedFrames = 0;
+    // Index and timings of every frame in the JSON export
+    std::vector<std::pair<uint64_t, FrameSample>> m_JsonSamples;
+
+  private:
+    void updateSummary();
+    bool exportCsv();
+    bool exportJson();
+};
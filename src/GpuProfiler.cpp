@@ -0,0 +1,137 @@
+#include "GpuProfiler.hpp"
+
+#include "VkCheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cassert>
+
+void GpuProfiler::create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                         uint32_t framesInFlight)
+{
+    m_Device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+
+    m_Supported = properties.limits.timestampComputeAndGraphics && validBits > 0;
+    m_TimestampPeriod = properties.limits.timestampPeriod;
+    m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    if (!m_Supported)
+    {
+        spdlog::warn("Timestamp queries not supported, GPU profiler disabled");
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCI{};
+    queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCI.pNext = nullptr;
+    queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCI.queryCount = MAX_REGIONS * 2;
+
+    m_Frames.resize(framesInFlight);
+    for (FrameQueries& frame : m_Frames)
+    {
+        VK_CHECK(vkCreateQueryPool(m_Device, &queryPoolCI, nullptr, &frame.pool));
+        frame.regions.clear();
+    }
+
+    spdlog::info("Created GPU Profiler");
+}
+
+void GpuProfiler::free()
+{
+    for (FrameQueries& frame : m_Frames)
+    {
+        vkDestroyQueryPool(m_Device, frame.pool, nullptr);
+    }
+    m_Frames.clear();
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (!m_Supported) return;
+
+    m_FrameIndex = frameIndex;
+    FrameQueries& frame = m_Frames[frameIndex];
+
+    if (!frame.regions.empty())
+    {
+        uint32_t queryCount = static_cast<uint32_t>(frame.regions.size()) * 2;
+
+        // Timestamp and availability for each query
+        std::array<uint64_t, MAX_REGIONS * 2 * 2> results;
+        vkGetQueryPoolResults(m_Device, frame.pool, 0, queryCount, sizeof(results),
+                              results.data(), sizeof(uint64_t) * 2,
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        // Regions skipped by this frame, like the blit when tracing into the swapchain, must
+        // not keep adding their last timing to the total
+        for (Region& region : m_Regions)
+        {
+            region.milliseconds = 0.0f;
+        }
+        m_TotalMilliseconds = 0.0f;
+
+        for (size_t i = 0; i < frame.regions.size(); i++)
+        {
+            uint64_t begin = results[i * 4 + 0] & m_TimestampMask;
+            uint64_t end = results[i * 4 + 2] & m_TimestampMask;
+            bool available = results[i * 4 + 1] != 0 && results[i * 4 + 3] != 0;
+            if (!available) continue;
+
+            Region& region = m_Regions[frame.regions[i]];
+            // Masking the difference as well keeps it right when the counter wrapped
+            region.milliseconds = ((end - begin) & m_TimestampMask) * m_TimestampPeriod / 1e6f;
+            m_TotalMilliseconds += region.milliseconds;
+            region.history[region.historyOffset] = region.milliseconds;
+            region.historyOffset = (region.historyOffset + 1) % HISTORY_SIZE;
+        }
+    }
+
+    vkCmdResetQueryPool(commandBuffer, frame.pool, 0, MAX_REGIONS * 2);
+    frame.regions.clear();
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, const char* name)
+{
+    if (!m_Supported) return;
+
+    assert(m_OpenRegion < 0 && "GPU profiler regions cannot nest");
+
+    FrameQueries& frame = m_Frames[m_FrameIndex];
+    if (frame.regions.size() == MAX_REGIONS) return;
+
+    uint32_t query = static_cast<uint32_t>(frame.regions.size()) * 2;
+    frame.regions.push_back(findRegion(name));
+    m_OpenRegion = static_cast<int32_t>(query);
+
+    vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.pool, query);
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer)
+{
+    if (!m_Supported || m_OpenRegion < 0) return;
+
+    vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                         m_Frames[m_FrameIndex].pool, m_OpenRegion + 1);
+    m_OpenRegion = -1;
+}
+
+uint32_t GpuProfiler::findRegion(const char* name)
+{
+    for (size_t i = 0; i < m_Regions.size(); i++)
+    {
+        if (m_Regions[i].name == name) return static_cast<uint32_t>(i);
+    }
+
+    m_Regions.emplace_back();
+    m_Regions.back().name = name;
+    return static_cast<uint32_t>(m_Regions.size() - 1);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+// Timestamp queries around named regions of a frame. Each frame in flight has its own query
+// pool, which is read once that frame's fence has signalled so reading never stalls.
+class GpuProfiler
+{
+  public:
+    static const uint32_t MAX_REGIONS = 16;
+    static const uint32_t HISTORY_SIZE = 200;
+
+    struct Region {
+        std::string name;
+        // Zero when the latest collected frame did not record the region
+        float milliseconds = 0.0f;
+        // Ring of past timings, historyOffset is the oldest entry
+        std::array<float, HISTORY_SIZE> history{};
+        uint32_t historyOffset = 0;
+    };
+
+  public:
+    GpuProfiler() {}
+    GpuProfiler(GpuProfiler&) = delete;
+    GpuProfiler(GpuProfiler&&) = delete;
+
+    // queueFamily is the family the profiled command buffers are submitted to
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                uint32_t framesInFlight);
+    void free();
+
+    // Collects the results this frame slot recorded last time and resets its queries. Must be
+    // called after waiting on the frame's fence, before any region is recorded.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    void begin(VkCommandBuffer commandBuffer, const char* name);
+    void end(VkCommandBuffer commandBuffer);
+
+    const std::vector<Region>& getRegions() const { return m_Regions; }
+    // Sum of the regions the latest collected frame recorded
+    float getTotalMilliseconds() const { return m_TotalMilliseconds; }
+
+  private:
+    struct FrameQueries {
+        VkQueryPool pool;
+        // Region index of each begin/end query pair, in recording order
+        std::vector<uint32_t> regions;
+    };
+
+    VkDevice m_Device;
+    bool m_Supported = false;
+    float m_TimestampPeriod = 1.0f;
+    // Bits of a timestamp the queue family writes, the counter wraps past them
+    uint64_t m_TimestampMask = ~0ull;
+
+    std::vector<FrameQueries> m_Frames;
+    uint32_t m_FrameIndex = 0;
+    int32_t m_OpenRegion = -1;
+
+    std::vector<Region> m_Regions;
+    float m_TotalMilliseconds = 0.0f;
+
+  private:
+    uint32_t findRegion(const char* name);
+};
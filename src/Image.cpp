@@ -8,9 +8,10 @@ Image::~Image() { free(); }
 
 void Image::create(VmaAllocator allocator, VkFormat format, VkExtent3D extent, VkImageType type,
                    VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
-                   VkMemoryPropertyFlags memoryProperties)
+                   VkMemoryPropertyFlags memoryProperties, MemoryCategory category)
 {
     m_Allocator = allocator;
+    m_Category = category;
     m_Format = format;
     m_Extent = extent;
 
@@ -29,7 +30,11 @@ void Image::create(VmaAllocator allocator, VkFormat format, VkExtent3D extent, V
     VmaAllocationCreateInfo vmaImageCI{};
     vmaImageCI.usage = memoryUsage;
     vmaImageCI.requiredFlags = memoryProperties;
-    VK_CHECK(vmaCreateImage(m_Allocator, &imageCI, &vmaImageCI, &m_Image, &m_Allocation, nullptr));
+    VmaAllocationInfo allocationInfo;
+    VK_CHECK(vmaCreateImage(m_Allocator, &imageCI, &vmaImageCI, &m_Image, &m_Allocation,
+                            &allocationInfo));
+    m_Size = allocationInfo.size;
+    MemoryBudget::track(m_Category, m_Size);
 }
 
 void Image::createImageView(VkDevice device, VkImageViewType viewType)
@@ -61,7 +66,9 @@ void Image::free()
     if (m_Image != 0)
     {
         vmaDestroyImage(m_Allocator, m_Image, m_Allocation);
+        MemoryBudget::untrack(m_Category, m_Size);
         m_Image = 0;
+        m_Size = 0;
     }
 }
 
@@ -103,6 +110,27 @@ void Image::transition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayo
     vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
 }
 
+void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 srcStage,
+                   VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage,
+                   VkAccessFlags2 dstAccess)
+{
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.pNext = nullptr;
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &barrier;
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
 void Image::copyToImage(VkCommandBuffer commandBuffer, const Image& image)
 {
     Image::copyFromTo(commandBuffer, m_Image, image.m_Image, m_Extent, image.m_Extent);
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.h>
 
 #include "ImmediateSubmit.hpp"
+#include "MemoryBudget.hpp"
 
 class Image
 {
@@ -18,6 +19,9 @@ class Image
     VmaAllocator m_Allocator;
     VkDevice m_Device;
 
+    MemoryCategory m_Category;
+    VkDeviceSize m_Size = 0;
+
   public:
     Image();
     Image(Image&) = delete;
@@ -27,7 +31,8 @@ class Image
 
     void create(VmaAllocator allocator, VkFormat format, VkExtent3D extent, VkImageType type,
                 VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
-                VkMemoryPropertyFlags memoryProperties);
+                VkMemoryPropertyFlags memoryProperties,
+                MemoryCategory category = MemoryCategory::Other);
     void createImageView(VkDevice device, VkImageViewType viewType);
     void free();
 
@@ -47,3 +52,8 @@ class Image
     static void copyFromTo(VkCommandBuffer commandBuffer, VkImage src, VkImage dst,
                            VkExtent3D srcSize, VkExtent3D dstSize);
 };
+
+// Global memory barrier between two stages, for buffers and images that keep their layout
+void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 srcStage,
+                   VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage,
+                   VkAccessFlags2 dstAccess);
@@ -1,10 +1,15 @@
 #include "ImmediateSubmit.hpp"
 
+#include "Image.hpp"
 #include "VkCheck.hpp"
 
-VkFence ImmediateSubmit::m_Fence;
+std::array<ImmediateSubmit::Batch, ImmediateSubmit::BATCH_COUNT> ImmediateSubmit::m_Batches;
 VkCommandPool ImmediateSubmit::m_CommandPool;
-VkCommandBuffer ImmediateSubmit::m_CommandBuffer;
+
+uint64_t ImmediateSubmit::m_NextBatch = 1;
+bool ImmediateSubmit::m_BatchOpen = false;
+uint32_t ImmediateSubmit::m_BatchCommands = 0;
+VkDeviceSize ImmediateSubmit::m_BatchBytes = 0;
 
 VkDevice ImmediateSubmit::m_Device;
 VkQueue ImmediateSubmit::m_GraphicsQueue;
@@ -29,37 +34,70 @@ void ImmediateSubmit::init(VkDevice device, VkQueue graphicsQueue, uint32_t grap
     commandBufferAI.commandBufferCount = 1;
     commandBufferAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    VK_CHECK(vkAllocateCommandBuffers(m_Device, &commandBufferAI, &m_CommandBuffer));
-
     VkFenceCreateInfo fenceCI{};
     fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCI.pNext = nullptr;
     fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    VK_CHECK(vkCreateFence(device, &fenceCI, nullptr, &m_Fence));
+    for (Batch& batch : m_Batches)
+    {
+        VK_CHECK(vkAllocateCommandBuffers(m_Device, &commandBufferAI, &batch.commandBuffer));
+        VK_CHECK(vkCreateFence(device, &fenceCI, nullptr, &batch.fence));
+        batch.id = 0;
+    }
 }
 
 void ImmediateSubmit::submit(std::function<void(VkCommandBuffer cmd)>&& function)
 {
-    VK_CHECK(vkResetFences(m_Device, 1, &m_Fence));
-    VK_CHECK(vkResetCommandBuffer(m_CommandBuffer, 0));
+    wait(enqueue(std::move(function)));
+}
 
-    VkCommandBufferBeginInfo commandBufferBI{};
-    commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBI.pNext = nullptr;
-    commandBufferBI.pInheritanceInfo = nullptr;
-    commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+void ImmediateSubmit::free()
+{
+    flush();
+
+    for (Batch& batch : m_Batches)
+    {
+        VK_CHECK(vkWaitForFences(m_Device, 1, &batch.fence, true, 1e10));
+        vkDestroyFence(m_Device, batch.fence, nullptr);
+    }
+    vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+}
+
+ImmediateSubmit::Handle ImmediateSubmit::enqueue(
+    std::function<void(VkCommandBuffer cmd)>&& function, VkDeviceSize size)
+{
+    if (!m_BatchOpen) beginBatch();
+
+    Batch& batch = m_Batches[m_NextBatch % BATCH_COUNT];
+
+    // Keeps the ordering callers had when every function was its own submit
+    fullBarrier(batch.commandBuffer);
+    function(batch.commandBuffer);
+
+    m_BatchCommands++;
+    m_BatchBytes += size;
 
-    VK_CHECK(vkBeginCommandBuffer(m_CommandBuffer, &commandBufferBI));
+    Handle handle = { .batch = batch.id };
+    if (m_BatchCommands >= MAX_BATCH_COMMANDS || m_BatchBytes >= MAX_BATCH_BYTES) flush();
 
-    function(m_CommandBuffer);
+    return handle;
+}
+
+ImmediateSubmit::Handle ImmediateSubmit::flush()
+{
+    if (!m_BatchOpen) return { .batch = m_NextBatch - 1 };
 
-    VK_CHECK(vkEndCommandBuffer(m_CommandBuffer));
+    Batch& batch = m_Batches[m_NextBatch % BATCH_COUNT];
+
+    // Later submissions on the queue see everything the batch wrote
+    fullBarrier(batch.commandBuffer);
+    VK_CHECK(vkEndCommandBuffer(batch.commandBuffer));
 
     VkCommandBufferSubmitInfo commandBufferSI{};
     commandBufferSI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
     commandBufferSI.pNext = nullptr;
-    commandBufferSI.commandBuffer = m_CommandBuffer;
+    commandBufferSI.commandBuffer = batch.commandBuffer;
     commandBufferSI.deviceMask = 0;
 
     VkSubmitInfo2 submitInfo{};
@@ -68,12 +106,62 @@ void ImmediateSubmit::submit(std::function<void(VkCommandBuffer cmd)>&& function
     submitInfo.commandBufferInfoCount = 1;
     submitInfo.pCommandBufferInfos = &commandBufferSI;
 
-    VK_CHECK(vkQueueSubmit2(m_GraphicsQueue, 1, &submitInfo, m_Fence));
-    VK_CHECK(vkWaitForFences(m_Device, 1, &m_Fence, true, 1e10));
+    VK_CHECK(vkQueueSubmit2(m_GraphicsQueue, 1, &submitInfo, batch.fence));
+
+    m_BatchOpen = false;
+    m_NextBatch++;
+
+    return { .batch = batch.id };
 }
 
-void ImmediateSubmit::free()
+bool ImmediateSubmit::isComplete(Handle handle)
 {
-    vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
-    vkDestroyFence(m_Device, m_Fence, nullptr);
+    if (m_BatchOpen && handle.batch == m_NextBatch) return false;
+
+    // A batch slot is only reused after its fence has been waited on
+    const Batch& batch = m_Batches[handle.batch % BATCH_COUNT];
+    if (batch.id != handle.batch) return true;
+
+    return vkGetFenceStatus(m_Device, batch.fence) == VK_SUCCESS;
+}
+
+void ImmediateSubmit::wait(Handle handle)
+{
+    if (m_BatchOpen && handle.batch == m_NextBatch) flush();
+
+    const Batch& batch = m_Batches[handle.batch % BATCH_COUNT];
+    if (batch.id != handle.batch) return;
+
+    VK_CHECK(vkWaitForFences(m_Device, 1, &batch.fence, true, 1e10));
+}
+
+void ImmediateSubmit::beginBatch()
+{
+    Batch& batch = m_Batches[m_NextBatch % BATCH_COUNT];
+
+    // Only blocks when every command buffer is still in flight
+    VK_CHECK(vkWaitForFences(m_Device, 1, &batch.fence, true, 1e10));
+    VK_CHECK(vkResetFences(m_Device, 1, &batch.fence));
+    VK_CHECK(vkResetCommandBuffer(batch.commandBuffer, 0));
+
+    VkCommandBufferBeginInfo commandBufferBI{};
+    commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBI.pNext = nullptr;
+    commandBufferBI.pInheritanceInfo = nullptr;
+    commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBI));
+
+    batch.id = m_NextBatch;
+    m_BatchOpen = true;
+    m_BatchCommands = 0;
+    m_BatchBytes = 0;
+}
+
+void ImmediateSubmit::fullBarrier(VkCommandBuffer commandBuffer)
+{
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                  VK_ACCESS_2_MEMORY_WRITE_BIT,
+                  VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
 }
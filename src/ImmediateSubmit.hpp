@@ -2,20 +2,53 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
 #include <functional>
 
 class ImmediateSubmit
 {
   public:
+    // Identifies the batch a function was recorded into
+    struct Handle {
+        uint64_t batch = 0;
+    };
+
     static void init(VkDevice device, VkQueue graphicsQueue, uint32_t graphicsQueueFamily);
     static void submit(std::function<void(VkCommandBuffer cmd)>&& function);
     static void free();
 
+    // Records into the open batch, which is submitted once it holds MAX_BATCH_COMMANDS
+    // functions or MAX_BATCH_BYTES of declared upload size, or on flush()
+    static Handle enqueue(std::function<void(VkCommandBuffer cmd)>&& function,
+                          VkDeviceSize size = 0);
+    static Handle flush();
+
+    static bool isComplete(Handle handle);
+    static void wait(Handle handle);
+
   private:
-    static VkFence m_Fence;
+    static const uint32_t BATCH_COUNT = 3;
+    static const uint32_t MAX_BATCH_COMMANDS = 256;
+    static const VkDeviceSize MAX_BATCH_BYTES = 64 * 1024 * 1024;
+
+    struct Batch {
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+        uint64_t id;
+    };
+
+    static std::array<Batch, BATCH_COUNT> m_Batches;
     static VkCommandPool m_CommandPool;
-    static VkCommandBuffer m_CommandBuffer;
+
+    static uint64_t m_NextBatch;
+    static bool m_BatchOpen;
+    static uint32_t m_BatchCommands;
+    static VkDeviceSize m_BatchBytes;
 
     static VkDevice m_Device;
     static VkQueue m_GraphicsQueue;
+
+  private:
+    static void beginBatch();
+    static void fullBarrier(VkCommandBuffer commandBuffer);
 };
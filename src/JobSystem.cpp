@@ -0,0 +1,300 @@
+#include "JobSystem.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+
+// Lets jobs find the queue of the worker running them
+static thread_local const JobSystem* s_CurrentPool = nullptr;
+static thread_local uint32_t s_CurrentIndex = 0;
+
+static double getTime()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+TaskGraph::Task TaskGraph::add(std::function<void()> function,
+                               std::initializer_list<Task> dependencies)
+{
+    Task task = static_cast<Task>(m_Nodes.size());
+
+    Node& node = m_Nodes.emplace_back();
+    node.function = std::move(function);
+    for (Task dependency : dependencies)
+    {
+        addDependency(task, dependency);
+    }
+
+    return task;
+}
+
+void TaskGraph::addDependency(Task task, Task dependency)
+{
+    m_Nodes[dependency].dependents.push_back(task);
+    m_Nodes[task].dependencyCount++;
+}
+
+JobSystem::~JobSystem() { free(); }
+
+void JobSystem::create(uint32_t workerCount)
+{
+    if (workerCount == 0) workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    m_Running = true;
+    m_StatsStart = getTime();
+
+    // Slot 0 is the calling thread, it has a queue but no thread of its own
+    for (uint32_t i = 0; i <= workerCount; i++)
+    {
+        m_Workers.push_back(std::make_unique<Worker>());
+    }
+
+    s_CurrentPool = this;
+    s_CurrentIndex = 0;
+
+    for (uint32_t i = 1; i <= workerCount; i++)
+    {
+        m_Workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+    }
+
+    spdlog::info("Created Job System with {} workers", workerCount);
+}
+
+void JobSystem::free()
+{
+    if (m_Workers.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Running = false;
+    }
+    m_SleepCondition.notify_all();
+
+    for (std::unique_ptr<Worker>& worker : m_Workers)
+    {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+    m_Workers.clear();
+    m_Background.clear();
+    m_Queued = 0;
+
+    if (s_CurrentPool == this) s_CurrentPool = nullptr;
+}
+
+void JobSystem::submit(std::function<void()> function, JobCounter* counter)
+{
+    if (counter != nullptr) counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+
+    push({ .function = std::move(function), .counter = counter });
+}
+
+void JobSystem::submitBackground(std::function<void()> function, JobCounter* counter)
+{
+    if (counter != nullptr) counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(m_BackgroundMutex);
+        m_Background.push_back({ .function = std::move(function), .counter = counter });
+        m_Queued.fetch_add(1);
+    }
+
+    wake();
+}
+
+void JobSystem::run(TaskGraph& graph, JobCounter& counter)
+{
+    counter.m_Count.fetch_add(static_cast<uint32_t>(graph.m_Nodes.size()),
+                              std::memory_order_relaxed);
+
+    // Every counter has to be set before the first task can finish and decrement one
+    for (TaskGraph::Node& node : graph.m_Nodes)
+    {
+        node.remaining.store(node.dependencyCount, std::memory_order_relaxed);
+    }
+
+    for (TaskGraph::Task task = 0; task < graph.m_Nodes.size(); task++)
+    {
+        if (graph.m_Nodes[task].dependencyCount == 0) runTask(graph, task, counter);
+    }
+}
+
+void JobSystem::runTask(TaskGraph& graph, TaskGraph::Task task, JobCounter& counter)
+{
+    auto function = [this, &graph, task, &counter]() {
+        TaskGraph::Node& node = graph.m_Nodes[task];
+        node.function();
+
+        for (TaskGraph::Task dependent : node.dependents)
+        {
+            if (graph.m_Nodes[dependent].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                runTask(graph, dependent, counter);
+        }
+    };
+
+    push({ .function = function, .counter = &counter });
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    uint32_t index = currentWorker();
+    while (!counter.isDone())
+    {
+        Job job;
+        if (pop(index, job, false))
+            execute(index, job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize,
+                            const std::function<void(uint32_t begin, uint32_t end)>& function)
+{
+    batchSize = std::max(batchSize, 1u);
+    if (count <= batchSize || m_Workers.size() <= 1)
+    {
+        if (count > 0) function(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (uint32_t begin = 0; begin < count; begin += batchSize)
+    {
+        uint32_t end = std::min(begin + batchSize, count);
+        submit([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+
+    wait(counter);
+}
+
+std::vector<WorkerStats> JobSystem::getStats() const
+{
+    std::vector<WorkerStats> stats;
+    stats.reserve(m_Workers.size());
+    for (const std::unique_ptr<Worker>& worker : m_Workers)
+    {
+        stats.push_back({ .tasksRun = worker->tasksRun.load(std::memory_order_relaxed),
+                          .steals = worker->steals.load(std::memory_order_relaxed),
+                          .idleTime = worker->idleNanoseconds.load(std::memory_order_relaxed) /
+                                      1e9 });
+    }
+
+    return stats;
+}
+
+double JobSystem::getUptime() const { return getTime() - m_StatsStart; }
+
+void JobSystem::resetStats()
+{
+    for (std::unique_ptr<Worker>& worker : m_Workers)
+    {
+        worker->tasksRun = 0;
+        worker->steals = 0;
+        worker->idleNanoseconds = 0;
+    }
+    m_StatsStart = getTime();
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+    s_CurrentPool = this;
+    s_CurrentIndex = index;
+
+    Worker& worker = *m_Workers[index];
+    while (true)
+    {
+        Job job;
+        if (pop(index, job, true))
+        {
+            execute(index, job);
+            continue;
+        }
+
+        auto idleStart = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_SleepCondition.wait(lock, [&] { return !m_Running || m_Queued.load() > 0; });
+            if (!m_Running) return;
+        }
+        auto idleTime = std::chrono::steady_clock::now() - idleStart;
+        worker.idleNanoseconds.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(idleTime).count(),
+            std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::push(Job job)
+{
+    Worker& worker = *m_Workers[currentWorker()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(std::move(job));
+        // Counted under the queue lock so a thief can never decrement it first
+        m_Queued.fetch_add(1);
+    }
+
+    wake();
+}
+
+void JobSystem::wake()
+{
+    // Taking the sleep lock orders this against a worker about to sleep
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+    }
+    m_SleepCondition.notify_one();
+}
+
+bool JobSystem::pop(uint32_t index, Job& job, bool background)
+{
+    // Newest job of the own queue first, it is the most likely to still be in cache
+    {
+        Worker& worker = *m_Workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty())
+        {
+            job = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+            m_Queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Then the oldest job of any other queue
+    uint32_t workerCount = static_cast<uint32_t>(m_Workers.size());
+    for (uint32_t i = 1; i < workerCount; i++)
+    {
+        Worker& victim = *m_Workers[(index + i) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+
+        job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        m_Queued.fetch_sub(1);
+
+        m_Workers[index]->steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (!background) return false;
+
+    std::lock_guard<std::mutex> lock(m_BackgroundMutex);
+    if (m_Background.empty()) return false;
+
+    job = std::move(m_Background.front());
+    m_Background.pop_front();
+    m_Queued.fetch_sub(1);
+    return true;
+}
+
+void JobSystem::execute(uint32_t index, Job& job)
+{
+    job.function();
+
+    m_Workers[index]->tasksRun.fetch_add(1, std::memory_order_relaxed);
+    if (job.counter != nullptr) job.counter->m_Count.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+uint32_t JobSystem::currentWorker() const { return s_CurrentPool == this ? s_CurrentIndex : 0; }
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Counts the jobs submitted against it that have not finished yet
+class JobCounter
+{
+  public:
+    JobCounter() {}
+    JobCounter(JobCounter&) = delete;
+    JobCounter(JobCounter&&) = delete;
+
+    bool isDone() const { return m_Count.load(std::memory_order_acquire) == 0; }
+    uint32_t getCount() const { return m_Count.load(std::memory_order_acquire); }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_Count = 0;
+};
+
+// Tasks with dependencies between them. A task is queued once every task it depends on has
+// finished. The graph must stay alive and unchanged until the counter it was run with is done.
+class TaskGraph
+{
+  public:
+    using Task = uint32_t;
+
+  public:
+    TaskGraph() {}
+    TaskGraph(TaskGraph&) = delete;
+    TaskGraph(TaskGraph&&) = delete;
+
+    // Dependencies must already have been added to the graph
+    Task add(std::function<void()> function, std::initializer_list<Task> dependencies = {});
+    void addDependency(Task task, Task dependency);
+
+    size_t getTaskCount() const { return m_Nodes.size(); }
+
+  private:
+    friend class JobSystem;
+
+    struct Node {
+        std::function<void()> function;
+        std::vector<Task> dependents;
+        uint32_t dependencyCount = 0;
+        // Dependencies still running while the graph runs
+        std::atomic<uint32_t> remaining = 0;
+    };
+
+    // Nodes hold atomics, so they are never moved
+    std::deque<Node> m_Nodes;
+};
+
+struct WorkerStats {
+    uint64_t tasksRun = 0;
+    // Tasks taken from another worker's queue
+    uint64_t steals = 0;
+    // Seconds spent asleep waiting for work
+    double idleTime = 0.0;
+};
+
+// Thread pool where every worker has its own queue. Workers take their newest job first and
+// steal the oldest job of another queue when theirs is empty. Jobs submitted from outside the
+// pool go to a queue owned by the calling thread, which takes part in the work while it waits.
+// Background jobs sit in a shared queue that only idle worker threads take from, so waiting on
+// a counter never runs one.
+class JobSystem
+{
+  public:
+    JobSystem() {}
+    JobSystem(JobSystem&) = delete;
+    JobSystem(JobSystem&&) = delete;
+
+    ~JobSystem();
+
+    // A workerCount of zero starts one worker per hardware thread besides the calling one
+    void create(uint32_t workerCount = 0);
+    // Every counter in use must be done first
+    void free();
+
+    void submit(std::function<void()> function, JobCounter* counter = nullptr);
+    // For long-running work nothing waits on within a frame
+    void submitBackground(std::function<void()> function, JobCounter* counter = nullptr);
+    void run(TaskGraph& graph, JobCounter& counter);
+
+    // Runs jobs until the counter is done, so it can also be called from inside a job
+    void wait(JobCounter& counter);
+
+    // Splits [0, count) into batches of batchSize and returns once all of them have run
+    void parallelFor(uint32_t count, uint32_t batchSize,
+                     const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+    // Worker threads plus the thread that created the pool
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+    // Index 0 is the thread that created the pool
+    std::vector<WorkerStats> getStats() const;
+    double getUptime() const;
+    void resetStats();
+
+  private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter* counter;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+
+        std::thread thread;
+        std::atomic<uint64_t> tasksRun = 0;
+        std::atomic<uint64_t> steals = 0;
+        std::atomic<uint64_t> idleNanoseconds = 0;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+    bool m_Running = false;
+    double m_StatsStart = 0.0;
+
+    std::mutex m_BackgroundMutex;
+    std::deque<Job> m_Background;
+
+    // Jobs sitting in any queue, sleeping workers wake up when it is non-zero
+    std::atomic<uint32_t> m_Queued = 0;
+    std::mutex m_SleepMutex;
+    std::condition_variable m_SleepCondition;
+
+  private:
+    void workerLoop(uint32_t index);
+
+    void push(Job job);
+    void wake();
+    // Background jobs are only taken when allowed and every other queue is empty
+    bool pop(uint32_t index, Job& job, bool background);
+    void execute(uint32_t index, Job& job);
+
+    void runTask(TaskGraph& graph, TaskGraph::Task task, JobCounter& counter);
+
+    uint32_t currentWorker() const;
+};
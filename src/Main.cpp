@@ -2,16 +2,97 @@
 
 #include "Engine.hpp"
 
+#include <cstdlib>
+#include <cstring>
+
 /*
  * TODO: Camera
  * TODO: Raytrace
  */
 
-int main()
+// --headless [--frames N] [--size WxH] [--timings path] [--dump-every N] [--dump-prefix path]
+//            [--cpu-reference]
+// [--retune-workgroups] [--gpu-budget ms] [--no-reprojection] [--no-depth-prepass]
+// [--no-swapchain-storage]
+static EngineOptions parseOptions(int argc, char** argv)
+{
+    EngineOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if (strcmp(arg, "--frames") == 0 && value)
+        {
+            options.frames = std::strtoul(value, nullptr, 10);
+            i++;
+        }
+        else if (strcmp(arg, "--size") == 0 && value)
+        {
+            char* separator;
+            options.width = std::strtoul(value, &separator, 10);
+            if (*separator == 'x') options.height = std::strtoul(separator + 1, nullptr, 10);
+            i++;
+        }
+        else if (strcmp(arg, "--timings") == 0 && value)
+        {
+            options.timingsPath = value;
+            i++;
+        }
+        else if (strcmp(arg, "--dump-every") == 0 && value)
+        {
+            options.dumpInterval = std::strtoul(value, nullptr, 10);
+            i++;
+        }
+        else if (strcmp(arg, "--dump-prefix") == 0 && value)
+        {
+            options.dumpPrefix = value;
+            i++;
+        }
+        else if (strcmp(arg, "--cpu-reference") == 0)
+        {
+            options.cpuReference = true;
+        }
+        else if (strcmp(arg, "--retune-workgroups") == 0)
+        {
+            options.retuneWorkgroups = true;
+        }
+        else if (strcmp(arg, "--gpu-budget") == 0 && value)
+        {
+            options.gpuBudget = std::strtof(value, nullptr);
+            i++;
+        }
+        else if (strcmp(arg, "--no-reprojection") == 0)
+        {
+            options.reprojection = false;
+        }
+        else if (strcmp(arg, "--no-depth-prepass") == 0)
+        {
+            options.depthPrepass = false;
+        }
+        else if (strcmp(arg, "--no-swapchain-storage") == 0)
+        {
+            options.traceToSwapchain = false;
+        }
+        else
+        {
+            spdlog::warn("Ignoring unknown argument {}", arg);
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv)
 {
     std::unique_ptr<Engine> engine = std::make_unique<Engine>();
 
-    engine->init();
+    engine->init(parseOptions(argc, argv));
     engine->start();
     engine->cleanup();
 
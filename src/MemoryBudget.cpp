@@ -0,0 +1,102 @@
+#include "MemoryBudget.hpp"
+
+#include "EventHandler.hpp"
+
+#include <spdlog/spdlog.h>
+
+static const char* s_CategoryNames[] = {
+    "Other", "World", "Octree", "Staging", "Frame", "Render targets", "Readback",
+};
+static_assert(std::size(s_CategoryNames) == static_cast<size_t>(MemoryCategory::Count));
+
+VmaAllocator MemoryBudget::s_Allocator;
+bool MemoryBudget::s_BudgetExtension = false;
+
+std::vector<MemoryBudget::Heap> MemoryBudget::s_Heaps;
+bool MemoryBudget::s_UnderPressure = false;
+
+std::array<std::atomic<VkDeviceSize>, static_cast<size_t>(MemoryCategory::Count)>
+    MemoryBudget::s_Categories;
+
+void MemoryBudget::init(VmaAllocator allocator, bool budgetExtension)
+{
+    s_Allocator = allocator;
+    s_BudgetExtension = budgetExtension;
+
+    const VkPhysicalDeviceMemoryProperties* properties;
+    vmaGetMemoryProperties(s_Allocator, &properties);
+
+    s_Heaps.resize(properties->memoryHeapCount);
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++)
+    {
+        s_Heaps[i].size = properties->memoryHeaps[i].size;
+        s_Heaps[i].deviceLocal =
+            (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    if (!s_BudgetExtension)
+        spdlog::warn("VK_EXT_memory_budget not supported, memory budgets are estimates");
+    spdlog::info("Created Memory Budget for {} heaps", s_Heaps.size());
+}
+
+void MemoryBudget::update(uint32_t frameIndex)
+{
+    // VMA only queries the driver's budget again after the frame index changes
+    vmaSetCurrentFrameIndex(s_Allocator, frameIndex);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(s_Allocator, budgets.data());
+
+    bool underPressure = false;
+    for (uint32_t i = 0; i < s_Heaps.size(); i++)
+    {
+        Heap& heap = s_Heaps[i];
+        heap.usage = budgets[i].usage;
+        heap.budget = budgets[i].budget;
+
+        if (!heap.deviceLocal || heap.usage <= heap.budget * PRESSURE_THRESHOLD)
+        {
+            heap.pressureUsage = 0;
+            continue;
+        }
+        underPressure = true;
+
+        // Receivers already responded to this much usage
+        if (heap.usage <= heap.pressureUsage) continue;
+
+        if (heap.pressureUsage == 0)
+        {
+            spdlog::warn("Memory heap {} under pressure: {} / {} MB", i, heap.usage >> 20,
+                         heap.budget >> 20);
+        }
+        heap.pressureUsage = heap.usage;
+
+        MemoryPressure pressure;
+        pressure.heap = i;
+        pressure.usage = heap.usage;
+        pressure.budget = heap.budget;
+        EventHandler::dispatch(pressure);
+    }
+
+    s_UnderPressure = underPressure;
+}
+
+void MemoryBudget::track(MemoryCategory category, VkDeviceSize size)
+{
+    s_Categories[static_cast<size_t>(category)].fetch_add(size, std::memory_order_relaxed);
+}
+
+void MemoryBudget::untrack(MemoryCategory category, VkDeviceSize size)
+{
+    s_Categories[static_cast<size_t>(category)].fetch_sub(size, std::memory_order_relaxed);
+}
+
+VkDeviceSize MemoryBudget::getUsage(MemoryCategory category)
+{
+    return s_Categories[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+}
+
+const char* MemoryBudget::getName(MemoryCategory category)
+{
+    return s_CategoryNames[static_cast<size_t>(category)];
+}
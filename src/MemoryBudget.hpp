@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+enum class MemoryCategory : uint32_t {
+    Other,
+    World,
+    Octree,
+    Staging,
+    Frame,
+    RenderTarget,
+    Readback,
+    Count
+};
+
+// Per-heap usage and budget, read from VMA once a frame, and the bytes allocated for each
+// category through Buffer and Image. A MemoryPressure event is dispatched when a device local
+// heap gets close to its budget, and again only when its usage grows further, so receivers
+// shed load once per step instead of every frame while usage stays put.
+class MemoryBudget
+{
+  public:
+    // Fraction of a heap's budget past which it is under pressure
+    static constexpr float PRESSURE_THRESHOLD = 0.9f;
+
+    struct Heap {
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize size = 0;
+        bool deviceLocal = false;
+        // Usage when the last MemoryPressure event went out, zero while below the threshold
+        VkDeviceSize pressureUsage = 0;
+    };
+
+  public:
+    // Without VK_EXT_memory_budget VMA estimates usage from its own allocations
+    static void init(VmaAllocator allocator, bool budgetExtension);
+
+    // Call once per frame on the main thread
+    static void update(uint32_t frameIndex);
+
+    // Safe from any thread
+    static void track(MemoryCategory category, VkDeviceSize size);
+    static void untrack(MemoryCategory category, VkDeviceSize size);
+
+    static const std::vector<Heap>& getHeaps() { return s_Heaps; }
+    static VkDeviceSize getUsage(MemoryCategory category);
+    static const char* getName(MemoryCategory category);
+    static bool hasBudgetExtension() { return s_BudgetExtension; }
+    static bool isUnderPressure() { return s_UnderPressure; }
+
+  private:
+    MemoryBudget() {}
+
+  private:
+    static VmaAllocator s_Allocator;
+    static bool s_BudgetExtension;
+
+    static std::vector<Heap> s_Heaps;
+    static bool s_UnderPressure;
+
+    static std::array<std::atomic<VkDeviceSize>, static_cast<size_t>(MemoryCategory::Count)>
+        s_Categories;
+};
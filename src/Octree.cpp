@@ -0,0 +1,156 @@
+#include "Octree.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+
+void Octree::build(const World& world, JobSystem* jobSystem)
+{
+    glm::uvec3 dimensions = world.getDimensions();
+
+    m_World = &world;
+    m_Dimensions = dimensions;
+    m_Origin = world.getOrigin();
+    m_Nodes.clear();
+
+    uint32_t maxDimension = std::max({ dimensions.x, dimensions.y, dimensions.z, 2u });
+    m_Depth = std::bit_width(maxDimension - 1);
+
+    // Reserve the root so it always lives at index 0
+    m_Nodes.push_back({ 0, 0 });
+
+    OctreeNode root;
+    bool parallel = jobSystem != nullptr && (getSize() >> SPLIT_DEPTH) >= BRICK_SIZE;
+    if (!parallel)
+    {
+        if (buildNode(glm::uvec3(0), getSize(), root, m_Nodes)) m_Nodes[0] = root;
+    }
+    else
+    {
+        m_SubtreeSize = getSize() >> SPLIT_DEPTH;
+        uint32_t perAxis = 1u << SPLIT_DEPTH;
+        m_Subtrees.resize(perAxis * perAxis * perAxis);
+
+        uint32_t subtreeCount = static_cast<uint32_t>(m_Subtrees.size());
+        jobSystem->parallelFor(subtreeCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                glm::uvec3 cell(i % perAxis, i / (perAxis * perAxis), (i / perAxis) % perAxis);
+
+                Subtree& subtree = m_Subtrees[i];
+                subtree.nodes.clear();
+                subtree.solid =
+                    buildNode(cell * m_SubtreeSize, m_SubtreeSize, subtree.root, subtree.nodes);
+            }
+        });
+
+        if (linkNode(glm::uvec3(0), getSize(), root)) m_Nodes[0] = root;
+    }
+
+    m_World = nullptr;
+    spdlog::info("Built octree: depth {}, {} nodes", m_Depth, m_Nodes.size());
+}
+
+bool Octree::buildNode(glm::uvec3 origin, uint32_t size, OctreeNode& node,
+                       std::vector<OctreeNode>& nodes) const
+{
+    if (origin.x >= m_Dimensions.x || origin.y >= m_Dimensions.y || origin.z >= m_Dimensions.z)
+        return false;
+
+    glm::ivec3 position = m_Origin + glm::ivec3(origin);
+    if (size == BRICK_SIZE &&
+        m_World->getBrick(position / static_cast<int32_t>(BRICK_SIZE)) == EMPTY_BRICK)
+        return false;
+
+    if (size == 1)
+    {
+        MaterialIndex material = m_World->getMaterial(position);
+        if (material == EMPTY_MATERIAL) return false;
+
+        node.childMask = 0;
+        node.data = material;
+        return true;
+    }
+
+    uint32_t halfSize = size / 2;
+
+    OctreeNode children[8];
+    uint32_t childMask = 0;
+    uint32_t childCount = 0;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        glm::uvec3 offset = glm::uvec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * halfSize;
+        if (buildNode(origin + offset, halfSize, children[childCount], nodes))
+        {
+            childMask |= 1u << i;
+            childCount++;
+        }
+    }
+
+    if (childMask == 0) return false;
+
+    node.childMask = childMask;
+    node.data = static_cast<uint32_t>(nodes.size());
+    nodes.insert(nodes.end(), children, children + childCount);
+
+    return true;
+}
+
+// Builds the top levels over the finished subtrees, appending each subtree's nodes with their
+// child indices moved to where they end up
+bool Octree::linkNode(glm::uvec3 origin, uint32_t size, OctreeNode& node)
+{
+    if (origin.x >= m_Dimensions.x || origin.y >= m_Dimensions.y || origin.z >= m_Dimensions.z)
+        return false;
+
+    if (size == m_SubtreeSize)
+    {
+        Subtree& subtree = m_Subtrees[subtreeIndex(origin)];
+        if (!subtree.solid) return false;
+
+        uint32_t base = static_cast<uint32_t>(m_Nodes.size());
+        for (OctreeNode child : subtree.nodes)
+        {
+            // Leaves keep their material in data
+            if (child.childMask != 0) child.data += base;
+            m_Nodes.push_back(child);
+        }
+
+        node = subtree.root;
+        if (node.childMask != 0) node.data += base;
+
+        subtree.nodes.clear();
+        return true;
+    }
+
+    uint32_t halfSize = size / 2;
+
+    OctreeNode children[8];
+    uint32_t childMask = 0;
+    uint32_t childCount = 0;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        glm::uvec3 offset = glm::uvec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * halfSize;
+        if (linkNode(origin + offset, halfSize, children[childCount]))
+        {
+            childMask |= 1u << i;
+            childCount++;
+        }
+    }
+
+    if (childMask == 0) return false;
+
+    node.childMask = childMask;
+    node.data = static_cast<uint32_t>(m_Nodes.size());
+    m_Nodes.insert(m_Nodes.end(), children, children + childCount);
+
+    return true;
+}
+
+uint32_t Octree::subtreeIndex(glm::uvec3 origin) const
+{
+    uint32_t perAxis = 1u << SPLIT_DEPTH;
+    glm::uvec3 cell = origin / m_SubtreeSize;
+    return cell.x + cell.z * perAxis + cell.y * perAxis * perAxis;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "World.hpp"
+
+// Children of a node are stored contiguously, in the order of the set bits of
+// childMask. Child i covers the octant offset by (i & 1, (i >> 1) & 1, (i >> 2) & 1).
+struct OctreeNode {
+    // Bits 0-7: which of the eight children exist
+    uint32_t childMask;
+    // Index of the first child for internal nodes, material index for leaves
+    uint32_t data;
+};
+
+class Octree
+{
+  public:
+    static const uint32_t SPLIT_DEPTH = 2;
+
+  public:
+    Octree() {}
+
+    // Builds the tree over the window of the world currently covered by its grid,
+    // skipping empty bricks wholesale. With a job system the subtrees below the top
+    // SPLIT_DEPTH levels are built in parallel.
+    void build(const World& world, JobSystem* jobSystem = nullptr);
+
+    const std::vector<OctreeNode>& getNodes() const { return m_Nodes; }
+    uint32_t getDepth() const { return m_Depth; }
+    uint32_t getSize() const { return 1u << m_Depth; }
+    // World position of the tree's minimum corner, in voxels
+    glm::ivec3 getOrigin() const { return m_Origin; }
+
+  private:
+    std::vector<OctreeNode> m_Nodes;
+    uint32_t m_Depth = 0;
+    glm::ivec3 m_Origin = glm::ivec3(0);
+
+    const World* m_World = nullptr;
+    glm::uvec3 m_Dimensions;
+
+  private:
+    struct Subtree {
+        bool solid = false;
+        OctreeNode root;
+        // Child indices are relative to the start of this vector until it is linked in
+        std::vector<OctreeNode> nodes;
+    };
+
+    uint32_t m_SubtreeSize = 0;
+    std::vector<Subtree> m_Subtrees;
+
+  private:
+    bool buildNode(glm::uvec3 origin, uint32_t size, OctreeNode& node,
+                   std::vector<OctreeNode>& nodes) const;
+    bool linkNode(glm::uvec3 origin, uint32_t size, OctreeNode& node);
+    uint32_t subtreeIndex(glm::uvec3 origin) const;
+};
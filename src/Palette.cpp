@@ -0,0 +1,71 @@
+#include "Palette.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <limits>
+
+Palette::Palette() {}
+
+void Palette::create(VmaAllocator allocator)
+{
+    m_Allocator = allocator;
+
+    m_Colours.clear();
+    m_Lookup.clear();
+    m_Colours.push_back(glm::vec4(0.0f));
+    m_Dirty = true;
+}
+
+void Palette::free()
+{
+    m_Buffer.free();
+    m_BufferCapacity = 0;
+
+    m_Colours.clear();
+    m_Lookup.clear();
+}
+
+MaterialIndex Palette::pack(const Voxel& voxel)
+{
+    if (voxel.colour.a == 0.0f) return EMPTY_MATERIAL;
+
+    uint32_t key = packColour(voxel.colour);
+
+    auto it = m_Lookup.find(key);
+    if (it != m_Lookup.end()) return it->second;
+
+    if (m_Colours.size() > std::numeric_limits<MaterialIndex>::max())
+    {
+        spdlog::error("Palette full, dropping colour {:08x}", key);
+        return EMPTY_MATERIAL;
+    }
+
+    MaterialIndex material = static_cast<MaterialIndex>(m_Colours.size());
+    m_Colours.push_back(unpackColour(key));
+    m_Lookup[key] = material;
+    m_Dirty = true;
+
+    return material;
+}
+
+Voxel Palette::unpack(MaterialIndex material) const { return { .colour = m_Colours.at(material) }; }
+
+void Palette::upload()
+{
+    if (!m_Dirty || m_Allocator == VK_NULL_HANDLE) return;
+
+    if (m_Colours.size() > m_BufferCapacity)
+    {
+        m_Buffer.free();
+        m_BufferCapacity = m_Colours.size();
+
+        m_Buffer.create(m_Allocator, m_BufferCapacity * sizeof(glm::vec4),
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::World);
+    }
+
+    m_Buffer.copyFromData<glm::vec4>(m_Colours);
+    m_Dirty = false;
+    spdlog::info("Uploaded Palette: {} materials", m_Colours.size());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vk_mem_alloc.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "Voxel.hpp"
+
+class Palette
+{
+  public:
+    Palette();
+    Palette(Palette&) = delete;
+    Palette(Palette&&) = delete;
+
+    void create(VmaAllocator allocator);
+    void free();
+
+    // Returns the material for the colour, adding it if no material with the same RGBA8
+    // value exists yet. Fully transparent colours map to EMPTY_MATERIAL.
+    MaterialIndex pack(const Voxel& voxel);
+    Voxel unpack(MaterialIndex material) const;
+
+    // Uploads the palette if materials were added since the last upload
+    void upload();
+
+    size_t getMaterialCount() const { return m_Colours.size(); }
+    const Buffer& getBuffer() const { return m_Buffer; }
+
+  private:
+    VmaAllocator m_Allocator;
+
+    std::vector<glm::vec4> m_Colours;
+    std::unordered_map<uint32_t, MaterialIndex> m_Lookup;
+
+    Buffer m_Buffer;
+    size_t m_BufferCapacity = 0;
+    bool m_Dirty = false;
+};
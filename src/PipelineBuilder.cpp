@@ -190,7 +190,7 @@ PipelineBuilder& PipelineBuilder::enableDepthTest(bool depthWriteEnable, VkCompa
     return *this;
 }
 
-VkPipeline PipelineBuilder::buildPipeline(VkDevice device)
+VkPipeline PipelineBuilder::buildPipeline(VkDevice device, VkPipelineCache cache)
 {
     VkPipelineViewportStateCreateInfo viewportCI{};
     viewportCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -233,8 +233,8 @@ VkPipeline PipelineBuilder::buildPipeline(VkDevice device)
     graphicsPipelineCI.layout = m_PipelineLayout;
 
     VkPipeline newPipeline;
-    VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &graphicsPipelineCI, nullptr,
-                                       &newPipeline));
+    VK_CHECK(
+        vkCreateGraphicsPipelines(device, cache, 1, &graphicsPipelineCI, nullptr, &newPipeline));
 
     return newPipeline;
 }
@@ -46,7 +46,8 @@ class PipelineBuilder
     PipelineBuilder& disableDepthTest();
     PipelineBuilder& enableDepthTest(bool depthWriteEnable, VkCompareOp compareOp);
 
-    VkPipeline buildPipeline(VkDevice device);
+    // Safe to call from several threads at once, also with the same cache
+    VkPipeline buildPipeline(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE);
 
   private:
     PipelineBuilder() {};
@@ -0,0 +1,121 @@
+#include "PipelineCache.hpp"
+
+#include "VkCheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+void PipelineCache::create(VkDevice device, VkPhysicalDevice physicalDevice,
+                           const std::string& path)
+{
+    m_Device = device;
+    m_Path = path;
+    vkGetPhysicalDeviceProperties(physicalDevice, &m_Properties);
+
+    std::vector<uint8_t> data;
+    m_Warm = load(data);
+
+    VkPipelineCacheCreateInfo pipelineCacheCI{};
+    pipelineCacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCI.pNext = nullptr;
+    pipelineCacheCI.initialDataSize = m_Warm ? data.size() : 0;
+    pipelineCacheCI.pInitialData = m_Warm ? data.data() : nullptr;
+
+    VK_CHECK(vkCreatePipelineCache(m_Device, &pipelineCacheCI, nullptr, &m_Cache));
+
+    spdlog::info("Created Pipeline Cache: {}", m_Warm ? "loaded " + m_Path : "empty");
+}
+
+void PipelineCache::free()
+{
+    if (m_Cache == VK_NULL_HANDLE) return;
+
+    save();
+
+    vkDestroyPipelineCache(m_Device, m_Cache, nullptr);
+    m_Cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save() const
+{
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(m_Device, m_Cache, &size, nullptr));
+
+    std::vector<uint8_t> data(size);
+    VkResult result = vkGetPipelineCacheData(m_Device, m_Cache, &size, data.data());
+    if (result != VK_SUCCESS)
+    {
+        spdlog::error("Failed to read pipeline cache: {}", string_VkResult(result));
+        return false;
+    }
+
+    // Written next to the old file first, so a crash mid-write never leaves a torn cache behind
+    std::string temporaryPath = m_Path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            spdlog::error("Failed to open {}", temporaryPath);
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), size);
+        if (!file.good())
+        {
+            spdlog::error("Failed to write {}", temporaryPath);
+            return false;
+        }
+    }
+
+    // Renaming over an existing file fails on Windows
+    if (std::rename(temporaryPath.c_str(), m_Path.c_str()) != 0)
+    {
+        std::remove(m_Path.c_str());
+        if (std::rename(temporaryPath.c_str(), m_Path.c_str()) != 0)
+        {
+            spdlog::error("Failed to replace {}", m_Path);
+            return false;
+        }
+    }
+
+    spdlog::info("Saved pipeline cache: {} bytes", size);
+    return true;
+}
+
+bool PipelineCache::load(std::vector<uint8_t>& data) const
+{
+    std::ifstream file(m_Path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) return false;
+
+    size_t size = static_cast<size_t>(file.tellg());
+    data.resize(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), size);
+
+    if (!file.good() || size < sizeof(VkPipelineCacheHeaderVersionOne))
+    {
+        spdlog::warn("Ignoring pipeline cache {}: truncated", m_Path);
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (header.headerSize < sizeof(header) || header.headerSize > size ||
+        header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    {
+        spdlog::warn("Ignoring pipeline cache {}: unknown header", m_Path);
+        return false;
+    }
+
+    if (header.vendorID != m_Properties.vendorID || header.deviceID != m_Properties.deviceID ||
+        memcmp(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        spdlog::warn("Ignoring pipeline cache {}: written by another device or driver", m_Path);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// VkPipelineCache backed by a file. The file is only used when its header was written by the
+// same driver for the same device, anything else starts an empty cache. The cache can be used
+// to create pipelines from several threads at once.
+class PipelineCache
+{
+  public:
+    PipelineCache() {}
+    PipelineCache(PipelineCache&) = delete;
+    PipelineCache(PipelineCache&&) = delete;
+
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& path);
+    // Saves the cache before destroying it
+    void free();
+
+    bool save() const;
+
+    VkPipelineCache getCache() const { return m_Cache; }
+    // Whether a valid cache was read from disk
+    bool isWarm() const { return m_Warm; }
+
+  private:
+    VkDevice m_Device;
+    VkPipelineCache m_Cache = VK_NULL_HANDLE;
+    std::string m_Path;
+    bool m_Warm = false;
+
+    VkPhysicalDeviceProperties m_Properties;
+
+  private:
+    bool load(std::vector<uint8_t>& data) const;
+};
@@ -0,0 +1,238 @@
+#include "StagingRing.hpp"
+
+#include "MemoryBudget.hpp"
+#include "VkCheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <map>
+
+VmaAllocator StagingRing::s_Allocator;
+VkBuffer StagingRing::s_Buffer;
+VmaAllocation StagingRing::s_Allocation;
+uint8_t* StagingRing::s_Mapped;
+VkDeviceSize StagingRing::s_Capacity;
+
+VkDeviceSize StagingRing::s_Head;
+VkDeviceSize StagingRing::s_Tail;
+std::deque<std::pair<TransferTicket, VkDeviceSize>> StagingRing::s_Submitted;
+
+std::vector<StagingRing::PendingCopy> StagingRing::s_Pending;
+
+static const VkDeviceSize COPY_ALIGNMENT = 16;
+
+void StagingRing::init(VmaAllocator allocator, VkDeviceSize size)
+{
+    s_Allocator = allocator;
+    s_Capacity = size;
+    s_Head = 0;
+    s_Tail = 0;
+
+    VkBufferCreateInfo bufferCI{};
+    bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCI.pNext = nullptr;
+    bufferCI.size = size;
+    bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo vmaACI{};
+    vmaACI.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    vmaACI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo;
+    VK_CHECK(
+        vmaCreateBuffer(s_Allocator, &bufferCI, &vmaACI, &s_Buffer, &s_Allocation, &allocationInfo));
+    s_Mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+    MemoryBudget::track(MemoryCategory::Staging, allocationInfo.size);
+
+    spdlog::info("Created Staging Ring with size: {}", size);
+}
+
+void StagingRing::free()
+{
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(s_Allocator, s_Allocation, &allocationInfo);
+    MemoryBudget::untrack(MemoryCategory::Staging, allocationInfo.size);
+
+    vmaDestroyBuffer(s_Allocator, s_Buffer, s_Allocation);
+    s_Buffer = 0;
+    s_Allocation = 0;
+    s_Mapped = nullptr;
+
+    s_Pending.clear();
+    s_Submitted.clear();
+}
+
+void StagingRing::upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    VkDeviceSize offset;
+    void* mapped = allocate(size, offset);
+    if (mapped != nullptr)
+    {
+        memcpy(mapped, data, size);
+        queueCopy(offset, dst, dstOffset, size);
+        return;
+    }
+
+    VkBufferCreateInfo bufferCI{};
+    bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCI.pNext = nullptr;
+    bufferCI.size = size;
+    bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo vmaACI{};
+    vmaACI.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    vmaACI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VkBuffer staging;
+    VmaAllocation stagingAllocation;
+    VmaAllocationInfo stagingInfo;
+    VK_CHECK(vmaCreateBuffer(s_Allocator, &bufferCI, &vmaACI, &staging, &stagingAllocation,
+                             &stagingInfo));
+    MemoryBudget::track(MemoryCategory::Staging, stagingInfo.size);
+
+    memcpy(stagingInfo.pMappedData, data, size);
+    vmaFlushAllocation(s_Allocator, stagingAllocation, 0, VK_WHOLE_SIZE);
+
+    // Anything already queued has to land first so later writes win
+    flush();
+
+    TransferTicket ticket = TransferQueue::submit([&](VkCommandBuffer cmd) {
+        VkBufferCopy copy{ .srcOffset = 0, .dstOffset = dstOffset, .size = size };
+        vkCmdCopyBuffer(cmd, staging, dst, 1, &copy);
+    });
+
+    VmaAllocator allocator = s_Allocator;
+    VkDeviceSize stagingSize = stagingInfo.size;
+    TransferQueue::onComplete(ticket, [=]() {
+        vmaDestroyBuffer(allocator, staging, stagingAllocation);
+        MemoryBudget::untrack(MemoryCategory::Staging, stagingSize);
+    });
+}
+
+void* StagingRing::allocate(VkDeviceSize size, VkDeviceSize& offset)
+{
+    if (size > s_Capacity) return nullptr;
+
+    reclaim();
+
+    VkDeviceSize start = (s_Head + COPY_ALIGNMENT - 1) & ~(COPY_ALIGNMENT - 1);
+    VkDeviceSize ringOffset = start % s_Capacity;
+
+    // Allocations never straddle the end of the ring
+    if (ringOffset + size > s_Capacity)
+    {
+        start += s_Capacity - ringOffset;
+        ringOffset = 0;
+    }
+
+    if (start + size - s_Tail > s_Capacity) return nullptr;
+
+    s_Head = start + size;
+    offset = ringOffset;
+
+    return s_Mapped + ringOffset;
+}
+
+void StagingRing::queueCopy(VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset,
+                            VkDeviceSize size)
+{
+    s_Pending.push_back(
+        { .dst = dst, .region = { .srcOffset = srcOffset, .dstOffset = dstOffset, .size = size } });
+}
+
+TransferTicket StagingRing::flush()
+{
+    if (s_Pending.empty()) return TransferQueue::getLastTicket();
+
+    TransferTicket ticket =
+        TransferQueue::submit([&](VkCommandBuffer cmd) { recordCopies(cmd); });
+    s_Submitted.push_back({ ticket, s_Head });
+
+    return ticket;
+}
+
+void StagingRing::reclaim()
+{
+    while (!s_Submitted.empty() && TransferQueue::isComplete(s_Submitted.front().first))
+    {
+        s_Tail = s_Submitted.front().second;
+        s_Submitted.pop_front();
+    }
+}
+
+// Appends the parts of the region outside the covered ranges, then adds the region to them.
+// Covered ranges map their first byte to one past their last and never touch each other.
+static void appendUncovered(const VkBufferCopy& region,
+                            std::map<VkDeviceSize, VkDeviceSize>& covered,
+                            std::vector<VkBufferCopy>& regions)
+{
+    VkDeviceSize begin = region.dstOffset;
+    VkDeviceSize end = region.dstOffset + region.size;
+
+    // First range that ends after the region begins
+    auto first = covered.upper_bound(begin);
+    if (first != covered.begin() && std::prev(first)->second >= begin) --first;
+
+    VkDeviceSize cursor = begin;
+    auto it = first;
+    for (; it != covered.end() && it->first <= end; it++)
+    {
+        if (it->first > cursor)
+        {
+            regions.push_back({ .srcOffset = region.srcOffset + (cursor - begin),
+                                .dstOffset = cursor,
+                                .size = it->first - cursor });
+        }
+        cursor = std::max(cursor, it->second);
+    }
+    if (cursor < end)
+    {
+        regions.push_back({ .srcOffset = region.srcOffset + (cursor - begin),
+                            .dstOffset = cursor,
+                            .size = end - cursor });
+    }
+
+    // Ranges overlapping or touching the region merge into one
+    if (first != it)
+    {
+        begin = std::min(begin, first->first);
+        end = std::max(end, std::prev(it)->second);
+    }
+    covered.erase(first, it);
+    covered.emplace(begin, end);
+}
+
+void StagingRing::recordCopies(VkCommandBuffer commandBuffer)
+{
+    if (s_Pending.empty()) return;
+
+    vmaFlushAllocation(s_Allocator, s_Allocation, 0, VK_WHOLE_SIZE);
+
+    // Group regions by destination, keeping submission order for repeated writes
+    std::stable_sort(s_Pending.begin(), s_Pending.end(),
+                     [](const PendingCopy& a, const PendingCopy& b) { return a.dst < b.dst; });
+
+    // Regions of one copy command must not overlap. Walking each destination's writes from the
+    // latest, only the bytes no later write covers are copied, so the latest write wins.
+    std::vector<VkBufferCopy> regions;
+    std::map<VkDeviceSize, VkDeviceSize> covered;
+    for (size_t i = s_Pending.size(); i-- > 0;)
+    {
+        appendUncovered(s_Pending[i].region, covered, regions);
+
+        if (i == 0 || s_Pending[i - 1].dst != s_Pending[i].dst)
+        {
+            vkCmdCopyBuffer(commandBuffer, s_Buffer, s_Pending[i].dst,
+                            static_cast<uint32_t>(regions.size()), regions.data());
+            regions.clear();
+            covered.clear();
+        }
+    }
+
+    // Ordering against the consumer comes from the transfer queue's semaphores
+
+    s_Pending.clear();
+}
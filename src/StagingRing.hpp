@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+
+#include "TransferQueue.hpp"
+
+// Persistently mapped staging memory shared by every upload. Copies are queued as they are
+// requested and submitted to the transfer queue in one batch per frame, and their space is
+// reclaimed once that batch's ticket has completed.
+class StagingRing
+{
+  public:
+    static void init(VmaAllocator allocator, VkDeviceSize size);
+    static void free();
+
+    // Copies the data into the ring and queues a copy into dst. Falls back to a dedicated
+    // staging buffer submitted right away when the ring has no room.
+    static void upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // Reserves space for the caller to fill, returns nullptr when the ring is full
+    static void* allocate(VkDeviceSize size, VkDeviceSize& offset);
+    static void queueCopy(VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset,
+                          VkDeviceSize size);
+
+    // Submits every queued copy, the returned ticket also covers all earlier uploads
+    static TransferTicket flush();
+
+    static VkDeviceSize getUsed() { return s_Head - s_Tail; }
+    static VkDeviceSize getCapacity() { return s_Capacity; }
+
+  private:
+    struct PendingCopy {
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+
+    static VmaAllocator s_Allocator;
+    static VkBuffer s_Buffer;
+    static VmaAllocation s_Allocation;
+    static uint8_t* s_Mapped;
+    static VkDeviceSize s_Capacity;
+
+    // Monotonic byte counters, positions in the ring are taken modulo the capacity
+    static VkDeviceSize s_Head;
+    static VkDeviceSize s_Tail;
+    // Ring head at each submission, released once its ticket completes
+    static std::deque<std::pair<TransferTicket, VkDeviceSize>> s_Submitted;
+
+    static std::vector<PendingCopy> s_Pending;
+
+  private:
+    static void reclaim();
+    static void recordCopies(VkCommandBuffer commandBuffer);
+};
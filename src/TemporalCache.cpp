@@ -0,0 +1,152 @@
+#include "TemporalCache.hpp"
+
+#include "ImmediateSubmit.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+void TemporalCache::create(VmaAllocator allocator, VkDevice device,
+                           DescriptorAllocator& descriptorAllocator, VkExtent3D extent,
+                           uint32_t framesInFlight)
+{
+    m_Allocator = allocator;
+    m_Device = device;
+
+    for (Image& history : m_History)
+    {
+        history.create(allocator, VK_FORMAT_R32G32B32A32_UINT, extent, VK_IMAGE_TYPE_2D,
+                       VK_IMAGE_USAGE_STORAGE_BIT, VMA_MEMORY_USAGE_GPU_ONLY,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::RenderTarget);
+        history.createImageView(m_Device, VK_IMAGE_VIEW_TYPE_2D);
+    }
+
+    m_Occluders.create(allocator, VK_FORMAT_R32_UINT, extent, VK_IMAGE_TYPE_2D,
+                       VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                       VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                       MemoryCategory::RenderTarget);
+    m_Occluders.createImageView(m_Device, VK_IMAGE_VIEW_TYPE_2D);
+
+    // All stay in the general layout, contents are ignored until a frame has written them
+    ImmediateSubmit::enqueue([&](VkCommandBuffer commandBuffer) {
+        for (Image& history : m_History)
+        {
+            history.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        }
+        m_Occluders.transition(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    });
+
+    m_Layout = DescriptorLayoutBuilder::start(m_Device)
+                   .addStorageImage(PREVIOUS_BINDING, VK_SHADER_STAGE_COMPUTE_BIT)
+                   .addStorageImage(CURRENT_BINDING, VK_SHADER_STAGE_COMPUTE_BIT)
+                   .addStorageImage(OCCLUDER_BINDING, VK_SHADER_STAGE_COMPUTE_BIT)
+                   .build();
+
+    // Set i writes history i and reads the other one
+    for (size_t i = 0; i < m_Sets.size(); i++)
+    {
+        m_Sets[i] =
+            DescriptorSetBuilder::start(m_Device, descriptorAllocator, m_Layout)
+                .addStorageImage(PREVIOUS_BINDING, VK_IMAGE_LAYOUT_GENERAL,
+                                 m_History[1 - i].getImageView())
+                .addStorageImage(CURRENT_BINDING, VK_IMAGE_LAYOUT_GENERAL,
+                                 m_History[i].getImageView())
+                .addStorageImage(OCCLUDER_BINDING, VK_IMAGE_LAYOUT_GENERAL,
+                                 m_Occluders.getImageView())
+                .build()
+                .at(0);
+    }
+    m_Current = 0;
+
+    m_Counters.create(allocator, sizeof(uint32_t) * framesInFlight,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                      VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::Readback);
+    m_CountersAddress = m_Counters.getDeviceAddress(m_Device);
+    m_Pixels.assign(framesInFlight, 0);
+
+    m_Valid = false;
+    m_HistoryValid = false;
+
+    spdlog::info("Created Temporal Cache: {}x{}", extent.width, extent.height);
+}
+
+void TemporalCache::free()
+{
+    m_Counters.free();
+    for (Image& history : m_History)
+    {
+        history.free();
+    }
+    m_Occluders.free();
+    vkDestroyDescriptorSetLayout(m_Device, m_Layout, nullptr);
+}
+
+void TemporalCache::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                               const Camera& camera, VkExtent2D extent)
+{
+    m_FrameIndex = frameIndex;
+
+    uint32_t* counters = static_cast<uint32_t*>(m_Counters.getAllocationInfo().pMappedData);
+    if (m_Pixels[frameIndex] > 0)
+    {
+        vmaInvalidateAllocation(m_Allocator, m_Counters.getAllocation(),
+                                sizeof(uint32_t) * frameIndex, sizeof(uint32_t));
+        uint64_t traced = std::min<uint64_t>(counters[frameIndex], m_Pixels[frameIndex]);
+        m_RaysSaved = 1.0f - static_cast<float>(traced) / m_Pixels[frameIndex];
+    }
+    counters[frameIndex] = 0;
+    vmaFlushAllocation(m_Allocator, m_Counters.getAllocation(),
+                       sizeof(uint32_t) * frameIndex, sizeof(uint32_t));
+    m_Pixels[frameIndex] = static_cast<uint64_t>(extent.width) * extent.height;
+
+    m_HistoryValid = m_Valid;
+
+    m_Current = 1 - m_Current;
+
+    // Last frame's writes to the history before this frame reads it, and its reads of the
+    // images this frame overwrites or clears
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+                  VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                      VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    if (isHistoryValid())
+    {
+        // Positive float bits order like the floats, so the splat keeps the nearest with a min
+        VkClearColorValue infinity{};
+        infinity.uint32[0] = 0x7F800000u;
+
+        VkImageSubresourceRange range{};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.levelCount = 1;
+        range.layerCount = 1;
+
+        vkCmdClearColorImage(commandBuffer, m_Occluders.getImage(), VK_IMAGE_LAYOUT_GENERAL,
+                             &infinity, 1, &range);
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_CLEAR_BIT,
+                      VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+
+    // The history was traced with the camera and extent of the last frame
+    m_PreviousCamera = m_TracedCamera;
+    m_TracedCamera = camera;
+    m_PreviousExtent = m_TracedExtent;
+    m_TracedExtent = extent;
+    m_Valid = true;
+}
+
+void TemporalCache::endFrame(VkCommandBuffer commandBuffer)
+{
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                  VK_PIPELINE_STAGE_2_HOST_BIT,
+                  VK_ACCESS_2_HOST_READ_BIT);
+}
+
+VkDeviceAddress TemporalCache::getCounterAddress() const
+{
+    return m_CountersAddress + sizeof(uint32_t) * m_FrameIndex;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "Camera.hpp"
+#include "Descriptors.hpp"
+#include "Image.hpp"
+
+// Last frame's primary hits, kept so pixels whose hit is still visible skip the trace. Two
+// history images hold the hit distance, voxel ID and colour of every pixel and swap each frame:
+// the raytracers read the previous one and write the current one. Before the trace, every
+// previous hit is splatted into the occluder image at the pixels it lands on this frame, keeping
+// the nearest distance, so a pixel can tell when something moved in front of its old hit. See
+// reprojection.glsl.
+//
+// layout (set = 2, binding = PREVIOUS_BINDING, rgba32ui) uniform readonly uimage2D h_Previous;
+// layout (set = 2, binding = CURRENT_BINDING, rgba32ui) uniform writeonly uimage2D h_Current;
+// layout (set = 2, binding = OCCLUDER_BINDING, r32ui) uniform uimage2D h_Occluders;
+class TemporalCache
+{
+  public:
+    static const uint32_t PREVIOUS_BINDING = 0;
+    static const uint32_t CURRENT_BINDING = 1;
+    static const uint32_t OCCLUDER_BINDING = 2;
+
+  public:
+    TemporalCache() {}
+    TemporalCache(TemporalCache&) = delete;
+    TemporalCache(TemporalCache&&) = delete;
+
+    // extent is the largest extent traced
+    void create(VmaAllocator allocator, VkDevice device, DescriptorAllocator& descriptorAllocator,
+                VkExtent3D extent, uint32_t framesInFlight);
+    void free();
+
+    // Reads how many rays the slot's last frame traced, swaps the history images and clears the
+    // occluders. Must be called after waiting on the frame's fence, before the splat and
+    // raytrace dispatches. Scene changes are handled per pixel by the shaders, against the
+    // region passed in the frame uniforms.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, const Camera& camera,
+                    VkExtent2D extent);
+    // Makes the ray counter visible to the host once the frame's fence signals
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    // Drops the history, the next frame traces every pixel
+    void invalidate() { m_Valid = false; }
+
+    // Set holding both history images for this frame
+    VkDescriptorSet getSet() const { return m_Sets[m_Current]; }
+    VkDescriptorSetLayout getLayout() const { return m_Layout; }
+    // uint the raytracers add traced pixels to
+    VkDeviceAddress getCounterAddress() const;
+    bool isHistoryValid() const { return m_Enabled && m_HistoryValid; }
+    const Camera& getPreviousCamera() const { return m_PreviousCamera; }
+    VkExtent2D getPreviousExtent() const { return m_PreviousExtent; }
+
+    void setEnabled(bool enabled) { m_Enabled = enabled; }
+    bool isEnabled() const { return m_Enabled; }
+
+    // Fraction of the pixels of the latest finished frame that reused their hit
+    float getRaysSaved() const { return m_RaysSaved; }
+
+  private:
+    VmaAllocator m_Allocator;
+    VkDevice m_Device;
+
+    std::array<Image, 2> m_History;
+    // Nearest splatted distance per pixel as float bits, cleared to infinity
+    Image m_Occluders;
+    VkDescriptorSetLayout m_Layout;
+    std::array<VkDescriptorSet, 2> m_Sets;
+    uint32_t m_Current = 0;
+
+    // One traced pixel counter per frame in flight
+    Buffer m_Counters;
+    VkDeviceAddress m_CountersAddress = 0;
+    std::vector<uint64_t> m_Pixels;
+    uint32_t m_FrameIndex = 0;
+    float m_RaysSaved = 0.0f;
+
+    bool m_Enabled = true;
+    // Whether the images hold a complete frame, and what it was traced with
+    bool m_Valid = false;
+    bool m_HistoryValid = false;
+    Camera m_PreviousCamera;
+    Camera m_TracedCamera;
+    VkExtent2D m_PreviousExtent = {};
+    VkExtent2D m_TracedExtent = {};
+};
@@ -0,0 +1,44 @@
+#include "Terrain.hpp"
+
+#include <array>
+
+ChunkGenerator createTerrainGenerator(Palette& palette)
+{
+    std::array<MaterialIndex, 4> materials = {
+        palette.pack({ .colour = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) }),
+        palette.pack({ .colour = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f) }),
+        palette.pack({ .colour = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) }),
+        palette.pack({ .colour = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f) }),
+    };
+
+    return [materials](glm::ivec3 chunkPosition, std::span<MaterialIndex> voxels) {
+        glm::ivec3 chunkOrigin = chunkPosition * static_cast<int32_t>(CHUNK_SIZE);
+        int32_t chunkSize = static_cast<int32_t>(CHUNK_SIZE);
+
+        for (int32_t z = 0; z < chunkSize; z++)
+        {
+            for (int32_t x = 0; x < chunkSize; x++)
+            {
+                int32_t worldX = chunkOrigin.x + x;
+                int32_t worldZ = chunkOrigin.z + z;
+
+                int32_t height =
+                    24 + static_cast<int32_t>(
+                             8.0f * glm::sin(worldX * 0.05f) * glm::cos(worldZ * 0.04f) +
+                             3.0f * glm::sin((worldX + worldZ) * 0.13f));
+
+                for (int32_t y = 0; y < chunkSize; y++)
+                {
+                    int32_t worldY = chunkOrigin.y + y;
+                    if (worldY < height) continue;
+
+                    uint32_t layerSum = (worldX + worldZ) & 1;
+                    uint32_t sum = (worldX + worldY + worldZ) & 1;
+
+                    voxels[x + z * chunkSize + y * chunkSize * chunkSize] =
+                        materials[layerSum * 2 + sum];
+                }
+            }
+        }
+    };
+}
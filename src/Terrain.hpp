@@ -0,0 +1,8 @@
+#pragma once
+
+#include "ChunkManager.hpp"
+#include "Palette.hpp"
+
+// Rolling hills in four checkerboard colours, which are added to the palette. +y points down,
+// so the ground fills everything below the height field.
+ChunkGenerator createTerrainGenerator(Palette& palette);
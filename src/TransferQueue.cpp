@@ -0,0 +1,231 @@
+#include "TransferQueue.hpp"
+
+#include "Image.hpp"
+#include "VkCheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+VkDevice TransferQueue::s_Device;
+VkQueue TransferQueue::s_Queue;
+uint32_t TransferQueue::s_QueueFamily;
+VkCommandPool TransferQueue::s_CommandPool;
+
+VkSemaphore TransferQueue::s_Timeline;
+uint64_t TransferQueue::s_NextValue = 1;
+
+VkSemaphore TransferQueue::s_ReleaseTimeline;
+uint64_t TransferQueue::s_ReleaseValue = 0;
+
+std::vector<VkCommandBuffer> TransferQueue::s_FreeCommandBuffers;
+std::deque<TransferQueue::Submission> TransferQueue::s_InFlight;
+std::deque<TransferQueue::Callback> TransferQueue::s_Callbacks;
+
+void TransferQueue::init(VkDevice device, VkQueue queue, uint32_t queueFamily)
+{
+    s_Device = device;
+    s_Queue = queue;
+    s_QueueFamily = queueFamily;
+    s_NextValue = 1;
+    s_ReleaseValue = 0;
+
+    VkCommandPoolCreateInfo commandPoolCI{};
+    commandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCI.pNext = nullptr;
+    commandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolCI.queueFamilyIndex = queueFamily;
+
+    VK_CHECK(vkCreateCommandPool(s_Device, &commandPoolCI, nullptr, &s_CommandPool));
+
+    s_Timeline = createTimeline();
+    s_ReleaseTimeline = createTimeline();
+
+    spdlog::info("Created Transfer Queue on family {}", queueFamily);
+}
+
+void TransferQueue::free()
+{
+    VK_CHECK(vkQueueWaitIdle(s_Queue));
+    collect();
+
+    vkDestroyCommandPool(s_Device, s_CommandPool, nullptr);
+    vkDestroySemaphore(s_Device, s_Timeline, nullptr);
+    vkDestroySemaphore(s_Device, s_ReleaseTimeline, nullptr);
+
+    s_FreeCommandBuffers.clear();
+    s_InFlight.clear();
+}
+
+TransferTicket TransferQueue::submit(std::function<void(VkCommandBuffer cmd)>&& function)
+{
+    collect();
+
+    VkCommandBuffer commandBuffer;
+    if (s_FreeCommandBuffers.empty())
+    {
+        VkCommandBufferAllocateInfo commandBufferAI{};
+        commandBufferAI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAI.pNext = nullptr;
+        commandBufferAI.commandPool = s_CommandPool;
+        commandBufferAI.commandBufferCount = 1;
+        commandBufferAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+        VK_CHECK(vkAllocateCommandBuffers(s_Device, &commandBufferAI, &commandBuffer));
+    }
+    else
+    {
+        commandBuffer = s_FreeCommandBuffers.back();
+        s_FreeCommandBuffers.pop_back();
+        VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    }
+
+    VkCommandBufferBeginInfo commandBufferBI{};
+    commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBI.pNext = nullptr;
+    commandBufferBI.pInheritanceInfo = nullptr;
+    commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBI));
+
+    // Copies from earlier submissions on this queue may target the same ranges
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                  VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                  VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    function(commandBuffer);
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    VkCommandBufferSubmitInfo commandBufferSI{};
+    commandBufferSI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    commandBufferSI.pNext = nullptr;
+    commandBufferSI.commandBuffer = commandBuffer;
+    commandBufferSI.deviceMask = 0;
+
+    // Only the consumer's second to last submission has to finish, the latest one can still run
+    // while this copies. Destinations are either unreachable from it, like brick slots the world
+    // retires for an upload, or are allowed to change under it.
+    VkSemaphoreSubmitInfo waitSI{};
+    waitSI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitSI.pNext = nullptr;
+    waitSI.semaphore = s_ReleaseTimeline;
+    waitSI.value = s_ReleaseValue > 0 ? s_ReleaseValue - 1 : 0;
+    waitSI.stageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    waitSI.deviceIndex = 0;
+
+    uint64_t value = s_NextValue++;
+
+    VkSemaphoreSubmitInfo signalSI{};
+    signalSI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalSI.pNext = nullptr;
+    signalSI.semaphore = s_Timeline;
+    signalSI.value = value;
+    signalSI.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    signalSI.deviceIndex = 0;
+
+    VkSubmitInfo2 submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreInfoCount = 1;
+    submitInfo.pWaitSemaphoreInfos = &waitSI;
+    submitInfo.signalSemaphoreInfoCount = 1;
+    submitInfo.pSignalSemaphoreInfos = &signalSI;
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &commandBufferSI;
+
+    VK_CHECK(vkQueueSubmit2(s_Queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    s_InFlight.push_back({ .commandBuffer = commandBuffer, .value = value });
+
+    return { value };
+}
+
+bool TransferQueue::isComplete(TransferTicket ticket) { return completedValue() >= ticket.value; }
+
+void TransferQueue::wait(TransferTicket ticket)
+{
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.pNext = nullptr;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &s_Timeline;
+    waitInfo.pValues = &ticket.value;
+
+    VK_CHECK(vkWaitSemaphores(s_Device, &waitInfo, UINT64_MAX));
+}
+
+void TransferQueue::onComplete(TransferTicket ticket, std::function<void()>&& function)
+{
+    s_Callbacks.push_back({ .value = ticket.value, .function = std::move(function) });
+}
+
+void TransferQueue::collect()
+{
+    uint64_t completed = completedValue();
+
+    while (!s_InFlight.empty() && s_InFlight.front().value <= completed)
+    {
+        s_FreeCommandBuffers.push_back(s_InFlight.front().commandBuffer);
+        s_InFlight.pop_front();
+    }
+
+    // Tickets are handed out in order, so callbacks complete in order as well
+    while (!s_Callbacks.empty() && s_Callbacks.front().value <= completed)
+    {
+        s_Callbacks.front().function();
+        s_Callbacks.pop_front();
+    }
+}
+
+VkSemaphoreSubmitInfo TransferQueue::waitInfo(TransferTicket ticket,
+                                              VkPipelineStageFlags2 stageMask)
+{
+    VkSemaphoreSubmitInfo waitSI{};
+    waitSI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitSI.pNext = nullptr;
+    waitSI.semaphore = s_Timeline;
+    waitSI.value = ticket.value;
+    waitSI.stageMask = stageMask;
+    waitSI.deviceIndex = 0;
+
+    return waitSI;
+}
+
+VkSemaphoreSubmitInfo TransferQueue::releaseInfo()
+{
+    VkSemaphoreSubmitInfo signalSI{};
+    signalSI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalSI.pNext = nullptr;
+    signalSI.semaphore = s_ReleaseTimeline;
+    signalSI.value = ++s_ReleaseValue;
+    signalSI.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    signalSI.deviceIndex = 0;
+
+    return signalSI;
+}
+
+uint64_t TransferQueue::completedValue()
+{
+    uint64_t value;
+    VK_CHECK(vkGetSemaphoreCounterValue(s_Device, s_Timeline, &value));
+    return value;
+}
+
+VkSemaphore TransferQueue::createTimeline()
+{
+    VkSemaphoreTypeCreateInfo semaphoreTypeCI{};
+    semaphoreTypeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCI.pNext = nullptr;
+    semaphoreTypeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCI.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCI{};
+    semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCI.pNext = &semaphoreTypeCI;
+
+    VkSemaphore semaphore;
+    VK_CHECK(vkCreateSemaphore(s_Device, &semaphoreCI, nullptr, &semaphore));
+
+    return semaphore;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Completion of a transfer submission, reached once the timeline semaphore passes value
+struct TransferTicket {
+    uint64_t value = 0;
+};
+
+// Asynchronous uploads on a dedicated transfer queue, or the graphics queue when the device has
+// none. Submissions never block the CPU, the render submission waits on their ticket instead.
+class TransferQueue
+{
+  public:
+    static void init(VkDevice device, VkQueue queue, uint32_t queueFamily);
+    static void free();
+
+    static TransferTicket submit(std::function<void(VkCommandBuffer cmd)>&& function);
+
+    static bool isComplete(TransferTicket ticket);
+    static void wait(TransferTicket ticket);
+
+    // Runs the function from collect() once the ticket has completed
+    static void onComplete(TransferTicket ticket, std::function<void()>&& function);
+    static void collect();
+
+    // For the consumer's submission, waits until the ticket's commands have executed
+    static VkSemaphoreSubmitInfo waitInfo(TransferTicket ticket, VkPipelineStageFlags2 stageMask);
+    // For the consumer's submission. Transfers wait on the one before the latest, so uploads
+    // overlap the submission still rendering the previous frame.
+    static VkSemaphoreSubmitInfo releaseInfo();
+
+    static TransferTicket getLastTicket() { return { s_NextValue - 1 }; }
+    static uint32_t getQueueFamily() { return s_QueueFamily; }
+
+  private:
+    struct Submission {
+        VkCommandBuffer commandBuffer;
+        uint64_t value;
+    };
+
+    struct Callback {
+        uint64_t value;
+        std::function<void()> function;
+    };
+
+    static VkDevice s_Device;
+    static VkQueue s_Queue;
+    static uint32_t s_QueueFamily;
+    static VkCommandPool s_CommandPool;
+
+    static VkSemaphore s_Timeline;
+    static uint64_t s_NextValue;
+
+    static VkSemaphore s_ReleaseTimeline;
+    static uint64_t s_ReleaseValue;
+
+    static std::vector<VkCommandBuffer> s_FreeCommandBuffers;
+    static std::deque<Submission> s_InFlight;
+    static std::deque<Callback> s_Callbacks;
+
+  private:
+    static uint64_t completedValue();
+    static VkSemaphore createTimeline();
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Voxels are stored as indices into the world palette, index 0 is reserved for empty space
+using MaterialIndex = uint16_t;
+
+constexpr MaterialIndex EMPTY_MATERIAL = 0;
+
+struct Voxel {
+    glm::vec4 colour;
+};
+
+inline uint32_t packColour(const glm::vec4& colour)
+{
+    glm::uvec4 bytes = glm::uvec4(glm::clamp(colour, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+}
+
+inline glm::vec4 unpackColour(uint32_t packed)
+{
+    return glm::vec4(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF, packed >> 24) /
+           255.0f;
+}
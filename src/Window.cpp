@@ -10,6 +10,9 @@
 Window::Window() {}
 Window::~Window()
 {
+    // Headless runs never create the window
+    if (m_Window == nullptr) return;
+
     spdlog::info("Destroying GLFW");
     glfwDestroyWindow(m_Window);
     glfwTerminate();
@@ -94,7 +97,7 @@ void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action,
     input.action = action;
     input.mods = mods;
 
-    EventHandler::dispatchEvent(&input);
+    EventHandler::post(input);
 }
 
 void Window::mouseMoveCallback(GLFWwindow* window, double xPos, double yPos)
@@ -123,7 +126,7 @@ void Window::mouseMoveCallback(GLFWwindow* window, double xPos, double yPos)
 
     event.captured = self->m_MouseCaptured;
 
-    EventHandler::dispatchEvent(&event);
+    EventHandler::post(event);
 }
 
 void Window::mouseEnterCallback(GLFWwindow* window, int entered)
@@ -29,7 +29,7 @@ class Window
 
   private:
     glm::uvec2 m_WindowSize;
-    GLFWwindow* m_Window;
+    GLFWwindow* m_Window = nullptr;
 
     bool m_MouseContained = false;
     bool m_MouseCaptured = false;
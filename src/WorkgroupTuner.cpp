@@ -0,0 +1,206 @@
+#include "WorkgroupTuner.hpp"
+
+#include "ImmediateSubmit.hpp"
+#include "Image.hpp"
+#include "VkCheck.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static const WorkgroupSize s_CandidateSizes[] = {
+    { 8,  4 },
+    { 8,  8 },
+    { 16, 4 },
+    { 16, 8 },
+    { 8,  16 },
+    { 32, 4 },
+    { 16, 16 },
+    { 32, 8 },
+};
+
+void WorkgroupTuner::create(VkDevice device, VkPhysicalDevice physicalDevice,
+                            uint32_t queueFamily, const std::string& path)
+{
+    m_Device = device;
+    m_Path = path;
+
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    idProperties.pNext = nullptr;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    m_DeviceId.clear();
+    for (uint8_t byte : idProperties.deviceUUID)
+    {
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02x", byte);
+        m_DeviceId += hex;
+    }
+
+    const VkPhysicalDeviceLimits& limits = properties.properties.limits;
+    m_Candidates.clear();
+    for (WorkgroupSize size : s_CandidateSizes)
+    {
+        if (size.x > limits.maxComputeWorkGroupSize[0] ||
+            size.y > limits.maxComputeWorkGroupSize[1] ||
+            size.x * size.y > limits.maxComputeWorkGroupInvocations)
+            continue;
+        m_Candidates.push_back(size);
+    }
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+
+    m_Supported = limits.timestampComputeAndGraphics && validBits > 0;
+    m_TimestampPeriod = limits.timestampPeriod;
+    m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    if (m_Supported)
+    {
+        VkQueryPoolCreateInfo queryPoolCI{};
+        queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCI.pNext = nullptr;
+        queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolCI.queryCount = TIMED_DISPATCHES * 2;
+
+        VK_CHECK(vkCreateQueryPool(m_Device, &queryPoolCI, nullptr, &m_QueryPool));
+    }
+    else
+    {
+        spdlog::warn("Timestamp queries not supported, workgroup sizes will not be tuned");
+    }
+
+    load();
+    spdlog::info("Created Workgroup Tuner with {} candidates", m_Candidates.size());
+}
+
+void WorkgroupTuner::free()
+{
+    if (m_QueryPool != VK_NULL_HANDLE) vkDestroyQueryPool(m_Device, m_QueryPool, nullptr);
+    m_QueryPool = VK_NULL_HANDLE;
+}
+
+bool WorkgroupTuner::save() const
+{
+    std::ofstream file(m_Path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        spdlog::error("Failed to open {}", m_Path);
+        return false;
+    }
+
+    for (const Entry& entry : m_Entries)
+    {
+        file << entry.device << " " << entry.shader << " " << entry.size.x << " " << entry.size.y
+             << "\n";
+    }
+
+    spdlog::info("Saved {} workgroup sizes to {}", m_Entries.size(), m_Path);
+    return file.good();
+}
+
+bool WorkgroupTuner::getCached(const std::string& shader, WorkgroupSize& size) const
+{
+    for (const Entry& entry : m_Entries)
+    {
+        if (entry.device != m_DeviceId || entry.shader != shader) continue;
+
+        size = entry.size;
+        return true;
+    }
+    return false;
+}
+
+void WorkgroupTuner::setCached(const std::string& shader, WorkgroupSize size)
+{
+    for (Entry& entry : m_Entries)
+    {
+        if (entry.device != m_DeviceId || entry.shader != shader) continue;
+
+        entry.size = size;
+        return;
+    }
+    m_Entries.push_back({ .device = m_DeviceId, .shader = shader, .size = size });
+}
+
+float WorkgroupTuner::measure(const std::function<void(VkCommandBuffer commandBuffer)>& dispatch)
+{
+    if (!m_Supported) return -1.0f;
+
+    ImmediateSubmit::submit([&](VkCommandBuffer commandBuffer) {
+        vkCmdResetQueryPool(commandBuffer, m_QueryPool, 0, TIMED_DISPATCHES * 2);
+
+        // The first dispatches only warm up caches and clocks
+        for (uint32_t i = 0; i < WARMUP_DISPATCHES + TIMED_DISPATCHES; i++)
+        {
+            bool timed = i >= WARMUP_DISPATCHES;
+            uint32_t query = (i - WARMUP_DISPATCHES) * 2;
+
+            if (timed)
+            {
+                vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                     m_QueryPool, query);
+            }
+            dispatch(commandBuffer);
+            if (timed)
+            {
+                vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                     m_QueryPool, query + 1);
+            }
+
+            memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                          VK_ACCESS_2_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                          VK_ACCESS_2_SHADER_WRITE_BIT);
+        }
+    });
+
+    std::array<uint64_t, TIMED_DISPATCHES * 2> results;
+    VK_CHECK(vkGetQueryPoolResults(m_Device, m_QueryPool, 0, TIMED_DISPATCHES * 2,
+                                   sizeof(results), results.data(), sizeof(uint64_t),
+                                   VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    std::array<float, TIMED_DISPATCHES> times;
+    for (uint32_t i = 0; i < TIMED_DISPATCHES; i++)
+    {
+        // Masked again after subtracting so a counter wrap between the pair still works out
+        uint64_t begin = results[i * 2] & m_TimestampMask;
+        uint64_t end = results[i * 2 + 1] & m_TimestampMask;
+        times[i] = ((end - begin) & m_TimestampMask) * m_TimestampPeriod / 1e6f;
+    }
+    std::nth_element(times.begin(), times.begin() + TIMED_DISPATCHES / 2, times.end());
+
+    return times[TIMED_DISPATCHES / 2];
+}
+
+void WorkgroupTuner::load()
+{
+    m_Entries.clear();
+
+    std::ifstream file(m_Path);
+    if (!file.is_open()) return;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        Entry entry;
+        if (!(stream >> entry.device >> entry.shader >> entry.size.x >> entry.size.y)) continue;
+
+        // A size this device cannot run would fail pipeline creation, it gets tuned again
+        if (entry.device == m_DeviceId &&
+            std::find(m_Candidates.begin(), m_Candidates.end(), entry.size) == m_Candidates.end())
+            continue;
+
+        m_Entries.push_back(entry);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct WorkgroupSize {
+    uint32_t x = 16;
+    uint32_t y = 16;
+
+    bool operator==(const WorkgroupSize&) const = default;
+};
+
+// Picks compute workgroup sizes by timing candidates on the GPU. Winners are kept in a text file
+// keyed by device UUID and shader, so each device only tunes once.
+class WorkgroupTuner
+{
+  public:
+    static const uint32_t WARMUP_DISPATCHES = 2;
+    static const uint32_t TIMED_DISPATCHES = 5;
+
+  public:
+    WorkgroupTuner() {}
+    WorkgroupTuner(WorkgroupTuner&) = delete;
+    WorkgroupTuner(WorkgroupTuner&&) = delete;
+
+    // queueFamily is the family ImmediateSubmit records the timed dispatches for
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                const std::string& path);
+    void free();
+
+    bool save() const;
+
+    // Sizes to try that fit the device limits
+    const std::vector<WorkgroupSize>& getCandidates() const { return m_Candidates; }
+
+    bool getCached(const std::string& shader, WorkgroupSize& size) const;
+    void setCached(const std::string& shader, WorkgroupSize size);
+
+    // Median GPU time of the dispatches recorded by dispatch(), in milliseconds. Each dispatch is
+    // followed by a compute barrier so they do not overlap. Negative without timestamp support.
+    float measure(const std::function<void(VkCommandBuffer commandBuffer)>& dispatch);
+
+    bool isSupported() const { return m_Supported; }
+
+  private:
+    struct Entry {
+        std::string device;
+        std::string shader;
+        WorkgroupSize size;
+    };
+
+    VkDevice m_Device;
+    VkQueryPool m_QueryPool = VK_NULL_HANDLE;
+    bool m_Supported = false;
+    float m_TimestampPeriod = 1.0f;
+    // Bits of a timestamp the queue family writes, the counter wraps past them
+    uint64_t m_TimestampMask = ~0ull;
+
+    std::string m_Path;
+    // Device UUID as hex
+    std::string m_DeviceId;
+    // Entries of every device seen, so tuning on one GPU does not forget another
+    std::vector<Entry> m_Entries;
+
+    std::vector<WorkgroupSize> m_Candidates;
+
+  private:
+    void load();
+};
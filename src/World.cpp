@@ -0,0 +1,421 @@
+#include "World.hpp"
+
+#include "StagingRing.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// Floor division, so negative positions land in the brick below them
+static glm::ivec3 brickPositionOf(glm::ivec3 position)
+{
+    glm::ivec3 size(BRICK_SIZE);
+    return (position - glm::ivec3(glm::lessThan(position, glm::ivec3(0))) * (size - 1)) / size;
+}
+
+World::World() {}
+
+World::~World() { free(); }
+
+void World::create(VmaAllocator allocator, glm::uvec3 gridDimensions, uint32_t brickCapacity)
+{
+    assert((gridDimensions.x & (gridDimensions.x - 1)) == 0 &&
+           (gridDimensions.y & (gridDimensions.y - 1)) == 0 &&
+           (gridDimensions.z & (gridDimensions.z - 1)) == 0 &&
+           "Grid dimensions must be powers of two");
+
+    m_Allocator = allocator;
+    m_GridDimensions = gridDimensions;
+    m_GridOrigin = glm::ivec3(0);
+    m_BrickCapacity = brickCapacity;
+    m_BrickCount = 0;
+
+    m_BrickGrid.assign(gridDimensions.x * gridDimensions.y * gridDimensions.z, EMPTY_BRICK);
+    m_Bricks.clear();
+    m_Bricks.reserve(brickCapacity);
+    m_FreeBricks.clear();
+    m_RetiredBricks.clear();
+
+    m_GridDirty = true;
+    m_DirtyBricks.clear();
+    m_BrickDirty.assign(brickCapacity, false);
+    m_ChangedRegion = {};
+    m_UploadedRegion = {};
+
+    m_Palette.create(allocator);
+
+    spdlog::info("Created World: {}x{}x{} bricks, {} brick capacity", gridDimensions.x,
+                 gridDimensions.y, gridDimensions.z, brickCapacity);
+
+    if (allocator == VK_NULL_HANDLE) return;
+
+    m_BrickGridBuffer.create(allocator, m_BrickGrid.size() * sizeof(uint32_t),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::World);
+
+    m_BrickPoolBuffer.create(allocator, brickCapacity * sizeof(Brick),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::World);
+
+}
+
+void World::free()
+{
+    m_BrickGridBuffer.free();
+    m_BrickPoolBuffer.free();
+    m_Palette.free();
+
+    m_BrickGrid.clear();
+    m_Bricks.clear();
+    m_FreeBricks.clear();
+    m_RetiredBricks.clear();
+    m_DirtyBricks.clear();
+    m_BrickDirty.clear();
+    m_ChangedRegion = {};
+    m_UploadedRegion = {};
+    m_BrickCount = 0;
+}
+
+void World::setGridOrigin(glm::ivec3 gridOrigin)
+{
+    if (gridOrigin == m_GridOrigin) return;
+
+    m_GridOrigin = gridOrigin;
+    m_Version++;
+}
+
+bool World::containsBrick(glm::ivec3 brickPosition) const
+{
+    glm::ivec3 local = brickPosition - m_GridOrigin;
+    return glm::all(glm::greaterThanEqual(local, glm::ivec3(0))) &&
+           glm::all(glm::lessThan(local, glm::ivec3(m_GridDimensions)));
+}
+
+void World::setVoxel(glm::ivec3 position, const Voxel& voxel)
+{
+    setMaterial(position, m_Palette.pack(voxel));
+}
+
+Voxel World::getVoxel(glm::ivec3 position) const
+{
+    return m_Palette.unpack(getMaterial(position));
+}
+
+void World::setMaterial(glm::ivec3 position, MaterialIndex material)
+{
+    glm::ivec3 brickPosition = brickPositionOf(position);
+    if (!containsBrick(brickPosition)) return;
+
+    uint32_t& cell = m_BrickGrid[gridIndex(brickPosition)];
+
+    bool solid = material != EMPTY_MATERIAL;
+    if (cell == EMPTY_BRICK)
+    {
+        if (!solid) return;
+
+        uint32_t brick = allocateBrick();
+        if (brick == EMPTY_BRICK) return;
+        cell = brick;
+        m_GridDirty = true;
+    }
+
+    m_ChangedRegion.add(brickPosition);
+
+    Brick& brick = m_Bricks[cell - 1];
+    uint32_t index =
+        brickVoxelIndex(glm::uvec3(position - brickPosition * static_cast<int32_t>(BRICK_SIZE)));
+
+    brick.materials[index] = material;
+    markBrickDirty(cell);
+
+    if (solid)
+    {
+        brick.occupancy[index / 32] |= 1u << (index % 32);
+        return;
+    }
+
+    brick.occupancy[index / 32] &= ~(1u << (index % 32));
+
+    for (uint32_t word : brick.occupancy)
+    {
+        if (word != 0) return;
+    }
+
+    freeBrick(cell);
+    cell = EMPTY_BRICK;
+    m_GridDirty = true;
+}
+
+MaterialIndex World::getMaterial(glm::ivec3 position) const
+{
+    glm::ivec3 brickPosition = brickPositionOf(position);
+    uint32_t brick = getBrick(brickPosition);
+    if (brick == EMPTY_BRICK) return EMPTY_MATERIAL;
+
+    glm::uvec3 local = glm::uvec3(position - brickPosition * static_cast<int32_t>(BRICK_SIZE));
+    return m_Bricks[brick - 1].materials[brickVoxelIndex(local)];
+}
+
+bool World::isSolid(glm::ivec3 position) const { return getMaterial(position) != EMPTY_MATERIAL; }
+
+bool World::setBrick(glm::ivec3 brickPosition, const MaterialIndex* materials)
+{
+    if (!containsBrick(brickPosition)) return true;
+
+    uint32_t occupancy[BRICK_VOXELS / 32] = {};
+    bool solid = false;
+    for (uint32_t i = 0; i < BRICK_VOXELS; i++)
+    {
+        if (materials[i] == EMPTY_MATERIAL) continue;
+
+        occupancy[i / 32] |= 1u << (i % 32);
+        solid = true;
+    }
+
+    if (!solid)
+    {
+        clearBrick(brickPosition);
+        return true;
+    }
+
+    uint32_t& cell = m_BrickGrid[gridIndex(brickPosition)];
+    if (cell == EMPTY_BRICK)
+    {
+        uint32_t brick = allocateBrick();
+        if (brick == EMPTY_BRICK) return false;
+        cell = brick;
+        m_GridDirty = true;
+    }
+
+    m_ChangedRegion.add(brickPosition);
+
+    Brick& brick = m_Bricks[cell - 1];
+    memcpy(brick.occupancy, occupancy, sizeof(occupancy));
+    memcpy(brick.materials, materials, sizeof(brick.materials));
+    markBrickDirty(cell);
+
+    return true;
+}
+
+void World::clearBrick(glm::ivec3 brickPosition)
+{
+    if (!containsBrick(brickPosition)) return;
+
+    uint32_t& cell = m_BrickGrid[gridIndex(brickPosition)];
+    if (cell == EMPTY_BRICK) return;
+
+    freeBrick(cell);
+    cell = EMPTY_BRICK;
+    m_GridDirty = true;
+    m_ChangedRegion.add(brickPosition);
+}
+
+uint32_t World::allocateBrick()
+{
+    uint32_t brick;
+    if (!m_FreeBricks.empty())
+    {
+        brick = m_FreeBricks.back();
+        m_FreeBricks.pop_back();
+    }
+    else if (m_Bricks.size() < m_BrickCapacity)
+    {
+        m_Bricks.emplace_back();
+        brick = static_cast<uint32_t>(m_Bricks.size());
+    }
+    else
+    {
+        return EMPTY_BRICK;
+    }
+
+    m_Bricks[brick - 1] = {};
+    m_BrickCount++;
+
+    return brick;
+}
+
+void World::freeBrick(uint32_t brick)
+{
+    assert(brick != EMPTY_BRICK && "Freeing empty brick");
+
+    // Nothing on the GPU reads a CPU only world
+    if (m_Allocator == VK_NULL_HANDLE)
+        m_FreeBricks.push_back(brick);
+    else
+        m_RetiredBricks.push_back(brick);
+    // A pending write would race the frame that can still read it
+    m_BrickDirty[brick - 1] = false;
+    m_BrickCount--;
+}
+
+uint32_t World::getBrick(glm::ivec3 brickPosition) const
+{
+    if (!containsBrick(brickPosition)) return EMPTY_BRICK;
+
+    return m_BrickGrid[gridIndex(brickPosition)];
+}
+
+bool World::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance,
+                    RaycastHit& hit) const
+{
+    // Keeps the reciprocals finite for axis-aligned rays
+    glm::vec3 safeDirection =
+        glm::mix(direction, glm::vec3(1e-8f), glm::lessThan(glm::abs(direction), glm::vec3(1e-8f)));
+    glm::vec3 inverse = 1.0f / safeDirection;
+
+    glm::ivec3 windowMin = getOrigin();
+    glm::ivec3 windowMax = windowMin + glm::ivec3(getDimensions());
+
+    // Clip to the window so the walk starts on its boundary
+    glm::vec3 t0 = (glm::vec3(windowMin) - origin) * inverse;
+    glm::vec3 t1 = (glm::vec3(windowMax) - origin) * inverse;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    if (entry > exit) return false;
+
+    glm::ivec3 step = glm::ivec3(glm::sign(safeDirection));
+    glm::vec3 delta = glm::abs(inverse);
+
+    glm::ivec3 voxel = glm::clamp(glm::ivec3(glm::floor(origin + direction * entry)), windowMin,
+                                  windowMax - 1);
+    glm::vec3 next =
+        (glm::vec3(voxel) + glm::max(glm::vec3(step), glm::vec3(0.0f)) - origin) * inverse;
+
+    glm::ivec3 normal(0);
+    if (entry > 0.0f)
+    {
+        int axis = tNear.x > tNear.y ? (tNear.x > tNear.z ? 0 : 2) : (tNear.y > tNear.z ? 1 : 2);
+        normal[axis] = -step[axis];
+    }
+
+    float distance = entry;
+    while (distance <= exit)
+    {
+        MaterialIndex material = getMaterial(voxel);
+        if (material != EMPTY_MATERIAL)
+        {
+            hit = {
+                .position = voxel, .normal = normal, .distance = distance, .material = material
+            };
+            return true;
+        }
+
+        int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+        distance = next[axis];
+        voxel[axis] += step[axis];
+        next[axis] += delta[axis];
+
+        normal = glm::ivec3(0);
+        normal[axis] = -step[axis];
+    }
+
+    return false;
+}
+
+void World::upload(JobSystem* jobSystem)
+{
+    if (m_Allocator == VK_NULL_HANDLE) return;
+
+    m_Palette.upload();
+
+    m_UploadedRegion = m_ChangedRegion;
+    m_ChangedRegion = {};
+    if (!m_GridDirty && m_DirtyBricks.empty()) return;
+
+    std::erase_if(m_DirtyBricks, [&](uint32_t brick) { return !m_BrickDirty[brick - 1]; });
+
+    if (m_GridDirty)
+    {
+        StagingRing::upload(m_BrickGridBuffer.getBuffer(), 0, m_BrickGrid.data(),
+                            m_BrickGrid.size() * sizeof(uint32_t));
+    }
+
+    // Ring space is reserved up front so the bricks can be copied into it in parallel. Whatever
+    // does not fit goes through StagingRing::upload afterwards, once the ring holds the rest.
+    std::vector<std::pair<uint32_t, uint8_t*>> staged;
+    staged.reserve(m_DirtyBricks.size());
+    for (uint32_t brick : m_DirtyBricks)
+    {
+        VkDeviceSize offset;
+        void* mapped = StagingRing::allocate(sizeof(Brick), offset);
+        if (mapped == nullptr) break;
+
+        staged.emplace_back(brick, static_cast<uint8_t*>(mapped));
+        StagingRing::queueCopy(offset, m_BrickPoolBuffer.getBuffer(), (brick - 1) * sizeof(Brick),
+                               sizeof(Brick));
+    }
+
+    auto copyBricks = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            memcpy(staged[i].second, &m_Bricks[staged[i].first - 1], sizeof(Brick));
+        }
+    };
+    if (jobSystem != nullptr)
+        jobSystem->parallelFor(static_cast<uint32_t>(staged.size()), UPLOAD_BATCH_SIZE, copyBricks);
+    else
+        copyBricks(0, static_cast<uint32_t>(staged.size()));
+
+    for (size_t i = staged.size(); i < m_DirtyBricks.size(); i++)
+    {
+        uint32_t brick = m_DirtyBricks[i];
+        StagingRing::upload(m_BrickPoolBuffer.getBuffer(), (brick - 1) * sizeof(Brick),
+                            &m_Bricks[brick - 1], sizeof(Brick));
+    }
+
+    for (uint32_t brick : m_DirtyBricks)
+    {
+        m_BrickDirty[brick - 1] = false;
+    }
+
+    // Later uploads wait for the frame that could still see the retired bricks
+    m_FreeBricks.insert(m_FreeBricks.end(), m_RetiredBricks.begin(), m_RetiredBricks.end());
+    m_RetiredBricks.clear();
+
+    m_GridDirty = false;
+    m_DirtyBricks.clear();
+    m_Version++;
+}
+
+void World::copyVoxels(const World& source)
+{
+    assert(source.m_GridDimensions == m_GridDimensions && "Copying between different grids");
+
+    // Assignment reuses the storage of earlier copies
+    m_GridOrigin = source.m_GridOrigin;
+    m_BrickGrid = source.m_BrickGrid;
+    m_Bricks = source.m_Bricks;
+    m_FreeBricks = source.m_FreeBricks;
+    m_FreeBricks.insert(m_FreeBricks.end(), source.m_RetiredBricks.begin(),
+                        source.m_RetiredBricks.end());
+    m_BrickCount = source.m_BrickCount;
+    m_Version = source.m_Version;
+}
+
+uint32_t World::gridIndex(glm::ivec3 brickPosition) const
+{
+    // Wrap with a mask so negative positions map into the grid as well
+    glm::uvec3 wrapped = glm::uvec3(brickPosition) & (m_GridDimensions - 1u);
+    return wrapped.x + wrapped.z * m_GridDimensions.x +
+           wrapped.y * m_GridDimensions.x * m_GridDimensions.z;
+}
+
+uint32_t World::brickVoxelIndex(glm::uvec3 localPosition)
+{
+    return localPosition.x + localPosition.z * BRICK_SIZE + localPosition.y * BRICK_SIZE * BRICK_SIZE;
+}
+
+void World::markBrickDirty(uint32_t brick)
+{
+    if (m_BrickDirty[brick - 1]) return;
+
+    m_BrickDirty[brick - 1] = true;
+    m_DirtyBricks.push_back(brick);
+}
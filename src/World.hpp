@@ -0,0 +1,157 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "JobSystem.hpp"
+#include "Palette.hpp"
+#include "Voxel.hpp"
+
+constexpr uint32_t BRICK_SIZE = 8;
+constexpr uint32_t BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+// Grid cells store a brick pool index offset by one, so zero marks an empty region
+constexpr uint32_t EMPTY_BRICK = 0;
+
+// Bricks copied into staging memory per job when uploading in parallel
+constexpr uint32_t UPLOAD_BATCH_SIZE = 64;
+
+struct Brick {
+    // One bit per voxel, set when the voxel is solid
+    uint32_t occupancy[BRICK_VOXELS / 32];
+    // Read on the GPU as BRICK_VOXELS / 2 words, with even voxels in the low half
+    MaterialIndex materials[BRICK_VOXELS];
+};
+
+// Box of world brick positions, inclusive, empty while min is past max
+struct BrickRegion {
+    glm::ivec3 min = glm::ivec3(std::numeric_limits<int32_t>::max());
+    glm::ivec3 max = glm::ivec3(std::numeric_limits<int32_t>::min());
+
+    bool isEmpty() const { return glm::any(glm::greaterThan(min, max)); }
+    void add(glm::ivec3 brickPosition) { add({ .min = brickPosition, .max = brickPosition }); }
+    void add(const BrickRegion& region)
+    {
+        min = glm::min(min, region.min);
+        max = glm::max(max, region.max);
+    }
+};
+
+struct RaycastHit {
+    glm::ivec3 position;
+    // Axis-aligned normal of the face the ray entered through
+    glm::ivec3 normal;
+    float distance;
+    MaterialIndex material;
+};
+
+// The brick grid is a window onto an unbounded world. Grid cells are addressed by world brick
+// position modulo the grid dimensions, so moving the window only touches the bricks that enter
+// or leave it.
+class World
+{
+  public:
+    World();
+    World(World&) = delete;
+    World(World&&) = delete;
+
+    ~World();
+
+    // gridDimensions is measured in bricks and must be a power of two on each axis,
+    // brickCapacity bounds the size of the brick pool. Without an allocator the world lives on the
+    // CPU only and upload() does nothing.
+    void create(VmaAllocator allocator, glm::uvec3 gridDimensions, uint32_t brickCapacity);
+    void free();
+
+    // Bricks leaving the window must already have been cleared
+    void setGridOrigin(glm::ivec3 gridOrigin);
+    glm::ivec3 getGridOrigin() const { return m_GridOrigin; }
+    glm::ivec3 getOrigin() const { return m_GridOrigin * static_cast<int32_t>(BRICK_SIZE); }
+    bool containsBrick(glm::ivec3 brickPosition) const;
+
+    void setVoxel(glm::ivec3 position, const Voxel& voxel);
+    Voxel getVoxel(glm::ivec3 position) const;
+
+    void setMaterial(glm::ivec3 position, MaterialIndex material);
+    MaterialIndex getMaterial(glm::ivec3 position) const;
+    bool isSolid(glm::ivec3 position) const;
+
+    // Replaces a whole brick, materials use the same layout as Brick::materials.
+    // Returns false when the brick pool is exhausted.
+    bool setBrick(glm::ivec3 brickPosition, const MaterialIndex* materials);
+    void clearBrick(glm::ivec3 brickPosition);
+
+    uint32_t allocateBrick();
+    void freeBrick(uint32_t brick);
+
+    // Returns the pool index of the brick at the world brick position offset by one,
+    // or EMPTY_BRICK
+    uint32_t getBrick(glm::ivec3 brickPosition) const;
+
+    // Steps voxel by voxel through the window, direction must be normalised for the hit
+    // distance to be in voxels. Returns false when nothing solid is hit within maxDistance.
+    bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, RaycastHit& hit) const;
+
+    // Uploads the grid and every brick changed since the last upload. With a job system the
+    // bricks are copied into staging memory in parallel.
+    void upload(JobSystem* jobSystem = nullptr);
+
+    // Copies the window, grid and bricks of a world with the same grid dimensions, so work on
+    // another thread can read a CPU only copy while the source keeps streaming. GPU buffers and
+    // the palette are left alone.
+    void copyVoxels(const World& source);
+
+    glm::uvec3 getGridDimensions() const { return m_GridDimensions; }
+    glm::uvec3 getDimensions() const { return m_GridDimensions * BRICK_SIZE; }
+    uint32_t getBrickCount() const { return m_BrickCount; }
+    uint32_t getBrickCapacity() const { return m_BrickCapacity; }
+    // Incremented by every upload that changed the world
+    uint64_t getVersion() const { return m_Version; }
+    // Bricks the latest upload changed, empty when it had nothing to do
+    const BrickRegion& getUploadedRegion() const { return m_UploadedRegion; }
+
+    Palette& getPalette() { return m_Palette; }
+    const Palette& getPalette() const { return m_Palette; }
+    const Buffer& getBrickGridBuffer() const { return m_BrickGridBuffer; }
+    const Buffer& getBrickPoolBuffer() const { return m_BrickPoolBuffer; }
+
+  private:
+    VmaAllocator m_Allocator = VK_NULL_HANDLE;
+
+    glm::uvec3 m_GridDimensions;
+    glm::ivec3 m_GridOrigin = glm::ivec3(0);
+    uint32_t m_BrickCapacity;
+    uint32_t m_BrickCount = 0;
+    uint64_t m_Version = 0;
+
+    std::vector<uint32_t> m_BrickGrid;
+    std::vector<Brick> m_Bricks;
+    std::vector<uint32_t> m_FreeBricks;
+    // Freed since the last upload. The frame still rendering can reach them through the grid it
+    // read, so they are only reused after the next upload.
+    std::vector<uint32_t> m_RetiredBricks;
+
+    bool m_GridDirty = false;
+    std::vector<uint32_t> m_DirtyBricks;
+    std::vector<bool> m_BrickDirty;
+    // Bricks changed since the last upload, and by it
+    BrickRegion m_ChangedRegion;
+    BrickRegion m_UploadedRegion;
+
+    Palette m_Palette;
+
+    Buffer m_BrickGridBuffer;
+    Buffer m_BrickPoolBuffer;
+
+  private:
+    uint32_t gridIndex(glm::ivec3 brickPosition) const;
+    static uint32_t brickVoxelIndex(glm::uvec3 localPosition);
+
+    void markBrickDirty(uint32_t brick);
+};